@@ -10,6 +10,9 @@
 #include <ranges>
 #include <variant>
 #include <cstring>
+#include <cstdlib>
+#include <cctype>
+#include <cerrno>
 #include <ox/io.h>
 #include <ox/std_abbreviation.h>
 
@@ -47,6 +50,19 @@ auto get_stream(puzzle_options opt) {
     return ox::ifstream_container<T>{filename};
 }
 
+// An input name of "bench<N>" asks the puzzles that support it to generate N entries instead of reading a file.
+// Anything but a positive N after "bench" is treated as an ordinary input name.
+inline std::optional<long> benchmark_size(puzzle_options opt) {
+    if (strncmp(opt.filename, "bench", 5) != 0 || !isdigit(static_cast<unsigned char>(opt.filename[5])))
+        return std::nullopt;
+    char* end = nullptr;
+    errno = 0;
+    long size = strtol(opt.filename + 5, &end, 10);
+    if (*end != '\0' || errno == ERANGE || size <= 0)
+        return std::nullopt;
+    return size;
+}
+
 template <typename T, typename C = std::vector<T>>
 C get_from_input(puzzle_options filename) {
     auto ss = get_stream<T>(filename);
@@ -0,0 +1,61 @@
+#ifndef ADVENTOFCODE_GRID_SEARCH_H
+#define ADVENTOFCODE_GRID_SEARCH_H
+
+#include <array>
+#include <climits>
+#include <cstddef>
+#include <optional>
+#include <utility>
+#include <vector>
+
+// Shortest paths over a width x height grid of cells addressed by index (y * width + x), for step costs that are
+// small non-negative integers. Distances live in one flat array and the frontier in a ring of max_step_cost + 1
+// buckets (Dial's algorithm), so there is no heap and nothing is allocated per expansion. The grid only exists
+// through step_cost, which is how a tiled grid can be searched without ever being built.
+//
+// step_cost(from, to) returns the cost of moving between two adjacent cells, or a negative value if the move is
+// not allowed. is_end(index) tells when the search is done.
+template <typename StepCost, typename IsEnd>
+std::optional<long> dial_shortest_path(
+        size_t width, size_t height, size_t start, int max_step_cost, StepCost step_cost, IsEnd is_end) {
+    std::vector<long> distance(width * height, LONG_MAX);
+    std::vector<std::vector<size_t>> buckets(static_cast<size_t>(max_step_cost) + 1);
+    size_t pending = 1;
+    distance[start] = 0;
+    buckets[0].push_back(start);
+
+    for (long current = 0; pending > 0; ++current) {
+        auto& bucket = buckets[static_cast<size_t>(current) % buckets.size()];
+        while (!bucket.empty()) {
+            size_t index = bucket.back();
+            bucket.pop_back();
+            --pending;
+            if (distance[index] != current)
+                continue;
+            if (is_end(index))
+                return current;
+
+            size_t x = index % width;
+            size_t y = index / width;
+            std::array<std::pair<bool, size_t>, 4> neighbours{{
+                    {y > 0, index - width},
+                    {y + 1 < height, index + width},
+                    {x > 0, index - 1},
+                    {x + 1 < width, index + 1},
+            }};
+            for (auto [valid, next] : neighbours) {
+                if (!valid)
+                    continue;
+                int cost = step_cost(index, next);
+                if (cost < 0 || current + cost >= distance[next])
+                    continue;
+                distance[next] = current + cost;
+                buckets[static_cast<size_t>(distance[next]) % buckets.size()].push_back(next);
+                ++pending;
+            }
+        }
+    }
+    return std::nullopt;
+}
+
+#endif // ADVENTOFCODE_GRID_SEARCH_H
@@ -1,20 +1,25 @@
 #include "../../../common.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cstdio>
+#include <random>
+#include <thread>
 #include <unordered_set>
 
 #define DAY 01
 
 namespace aoc2020::day01 {
-    std::pair<int, int> findsum(const std::unordered_set<int>& set, int target_sum) {
-        for (int i : set) {
+    std::pair<long, long> findsum(const std::unordered_set<long>& set, long target_sum) {
+        for (long i : set) {
             if (set.contains(target_sum - i))
                 return {i, target_sum - i};
         }
         return {0, target_sum};
     }
 
-    std::array<int, 3> find_triple_sum(const std::unordered_set<int>& set, int target_sum) {
-        for (int i : set) {
+    std::array<long, 3> find_triple_sum(const std::unordered_set<long>& set, long target_sum) {
+        for (long i : set) {
             auto [a, b] = findsum(set, target_sum - i);
             if (a)
                 return {i, a, b};
@@ -22,19 +27,184 @@ namespace aoc2020::day01 {
         return {0, 0, target_sum};
     }
 
+    // The entries sorted, with a presence bitmap over their value range when that range is not much wider than the
+    // number of entries. Every search picks entries at distinct positions in ascending order, so the last entry of a
+    // sum is a single lookup among the entries after the previous one.
+    class ledger {
+        std::vector<long> sorted;
+        std::vector<uint64_t> present;
+
+        [[nodiscard]] bool test(long value) const {
+            auto bit = uint64_t(value - sorted.front());
+            return bit < 64 * present.size() && (present[bit / 64] >> (bit % 64) & 1);
+        }
+
+        // Whether an entry at position first or later has this value
+        [[nodiscard]] bool contains_from(size_t first, long value) const {
+            if (first >= sorted.size() || value < sorted[first])
+                return false;
+            if (value == sorted[first])
+                return true;
+            if (!present.empty())
+                return test(value);
+            return std::binary_search(sorted.begin() + long(first), sorted.end(), value);
+        }
+
+        // Two entries from position first on, closing in from both ends
+        bool find_pair(size_t first, long target, std::vector<long>& chosen) const {
+            if (first >= sorted.size())
+                return false;
+            for (size_t lo = first, hi = sorted.size() - 1; lo < hi;) {
+                long sum = sorted[lo] + sorted[hi];
+                if (sum == target) {
+                    chosen.insert(chosen.end(), {sorted[hi], sorted[lo]});
+                    return true;
+                }
+                sum < target ? ++lo : --hi;
+            }
+            return false;
+        }
+
+        // The choices are appended in reverse, innermost first
+        bool find(size_t first, int k, long target, std::vector<long>& chosen) const {
+            if (k == 1) {
+                if (!contains_from(first, target))
+                    return false;
+                chosen.push_back(target);
+                return true;
+            }
+            if (k == 2 && present.empty())
+                return find_pair(first, target, chosen);
+            size_t start = std::max(first, lowest_useful(k, target));
+            for (size_t i = start; i < sorted.size() && k * sorted[i] <= target; ++i) {
+                if (i > start && sorted[i] == sorted[i - 1])
+                    continue;
+                if (find(i + 1, k - 1, target - sorted[i], chosen)) {
+                    chosen.push_back(sorted[i]);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // Entries before this one are too small to reach target even with the largest entry for all others
+        [[nodiscard]] size_t lowest_useful(int k, long target) const {
+            long needed = target - (k - 1) * sorted.back();
+            return size_t(stdr::lower_bound(sorted, needed) - sorted.begin());
+        }
+
+    public:
+        explicit ledger(std::vector<long> entries) : sorted(std::move(entries)) {
+            stdr::sort(sorted);
+            if (sorted.empty())
+                return;
+            auto span = uint64_t(sorted.back() - sorted.front()) + 1;
+            if (span > std::max<uint64_t>(64 * sorted.size(), 1 << 16))
+                return;
+            present.resize((span + 63) / 64);
+            for (long v : sorted)
+                present[uint64_t(v - sorted.front()) / 64] |= uint64_t(1) << (uint64_t(v - sorted.front()) % 64);
+        }
+
+        [[nodiscard]] size_t size() const { return sorted.size(); }
+
+        // k entries at distinct positions summing to target, in ascending order. The choice of the first entry is
+        // split across threads in blocks, and the answer with the smallest first entry wins, so it does not depend
+        // on the scheduling.
+        [[nodiscard]] std::optional<std::vector<long>> find_sum(int k, long target) const {
+            if (k < 1)
+                return std::nullopt;
+            if (k == 1 || sorted.empty())
+                return contains_from(0, target) ? std::optional(std::vector{target}) : std::nullopt;
+
+            constexpr size_t block = 256;
+            std::atomic<size_t> next = lowest_useful(k, target);
+            std::atomic<size_t> best = sorted.size();
+            std::vector<std::vector<long>> found(std::max(1u, std::thread::hardware_concurrency()));
+            std::vector<std::thread> workers;
+            for (size_t w = 0; w < found.size(); ++w) {
+                workers.emplace_back([&, w] {
+                    std::vector<long> chosen;
+                    for (size_t from; (from = next.fetch_add(block)) < std::min(best.load(), sorted.size());) {
+                        for (size_t i = from; i < std::min(from + block, sorted.size()) && i < best; ++i) {
+                            if (k * sorted[i] > target)
+                                return;
+                            if (i > 0 && sorted[i] == sorted[i - 1])
+                                continue;
+                            chosen.clear();
+                            if (!find(i + 1, k - 1, target - sorted[i], chosen))
+                                continue;
+                            chosen.push_back(sorted[i]);
+                            for (size_t current = best; i < current && !best.compare_exchange_weak(current, i);) {}
+                            found[w] = {chosen.rbegin(), chosen.rend()};
+                            return;
+                        }
+                    }
+                });
+            }
+            for (auto& worker : workers) {
+                worker.join();
+            }
+            for (const auto& f : found) {
+                if (best < sorted.size() && !f.empty() && f.front() == sorted[best])
+                    return f;
+            }
+            return std::nullopt;
+        }
+    };
+
+    // bench<N> asks for N random entries, with a target that is the sum of `parts` of them
+    std::pair<std::vector<long>, long> get_expenses(puzzle_options filename, int parts) {
+        if (auto size = benchmark_size(filename)) {
+            std::mt19937 gen(1);
+            std::uniform_int_distribution<long> entry(1, 4 * *size);
+            std::vector<long> entries(size_t(std::max(long(parts), *size)));
+            stdr::generate(entries, [&] { return entry(gen); });
+            long target = 0;
+            for (int i = 0; i < parts; ++i)
+                target += entries[size_t(i)];
+            return {entries, target};
+        }
+        auto input_vector = get_stream<long>(filename);
+        return {{input_vector.begin(), input_vector.end()}, 2020};
+    }
+
+    // Times the ledger against the hash set probing it replaces
+    template <typename HashSearch>
+    std::vector<long> timed_find_sum(puzzle_options filename, int parts, HashSearch hash_search) {
+        auto [entries, target] = get_expenses(filename, parts);
+        auto start = std::chrono::steady_clock::now();
+        ledger l(entries);
+        auto res = l.find_sum(parts, target).value_or(std::vector<long>(size_t(parts), 0));
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+        if (benchmark_size(filename)) {
+            start = std::chrono::steady_clock::now();
+            std::unordered_set<long> set(entries.begin(), entries.end());
+            hash_search(set, target);
+            std::chrono::duration<double, std::milli> hash_elapsed = std::chrono::steady_clock::now() - start;
+            myprintf("Found %d entries summing to %ld among %zu in %.3f ms (hash set: %.3f ms)\n",
+                     parts,
+                     target,
+                     l.size(),
+                     elapsed.count(),
+                     hash_elapsed.count());
+        }
+        return res;
+    }
+
     answertype puzzle1(puzzle_options filename) {
-        auto input_vector = get_stream<int>(filename);
-        std::unordered_set expenses(input_vector.begin(), input_vector.end());
-        auto [exp1, exp2] = findsum(expenses, 2020);
-        printf("expense 1 was %d\nexpense 2 was %d\ntheir product is %d\n\n", exp1, exp2, exp1 * exp2);
+        auto res = timed_find_sum(filename, 2, findsum);
+        long exp1 = res[0], exp2 = res[1];
+        printf("expense 1 was %ld\nexpense 2 was %ld\ntheir product is %ld\n\n", exp1, exp2, exp1 * exp2);
         return exp1 * exp2;
     }
 
     answertype puzzle2(puzzle_options filename) {
-        auto input_vector = get_stream<int>(filename);
-        std::unordered_set expenses(input_vector.begin(), input_vector.end());
-        auto [a, b, c] = find_triple_sum(expenses, 2020);
-        printf("expense 1 was %d\nexpense 2 was %d\nexpense 3 was %d\ntheir product is %d", a, b, c, a * b * c);
-        return a * b * c;
+        auto res = timed_find_sum(filename, 3, find_triple_sum);
+        long a = res[0], b = res[1], c = res[2];
+        long product = long(uint64_t(a) * uint64_t(b) * uint64_t(c));
+        printf("expense 1 was %ld\nexpense 2 was %ld\nexpense 3 was %ld\ntheir product is %ld", a, b, c, product);
+        return product;
     }
-}
\ No newline at end of file
+}
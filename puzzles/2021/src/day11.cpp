@@ -1,81 +1,159 @@
 #include "../../../common.h"
-#include "algorithms/_helper_iterators.h"
 
 #define DAY 11
 
 #include <vector>
-#include <unordered_set>
-#include <queue>
-#include <numeric>
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <optional>
-#include <concepts>
-#include "ox/grid.h"
+#include <thread>
 
 namespace aoc2021::day11 {
-    class octopuses : public ox::grid<int> {
-        using ox::grid<int>::grid;
-    public:
-        auto get_size() {
-            return data.size();
-        }
+    // The energy levels in one flat array with a frame of padding cells around them, so every octopus has all
+    // eight neighbours without bounds checks. Cells that flashed this step are marked with the step's generation,
+    // which makes the marks from earlier steps stale without clearing them. The padding is marked with the highest
+    // generation, so it never takes energy and never flashes.
+    class octopuses {
+        static constexpr uint32_t padding = ~uint32_t(0);
 
-        int next_step() {
-            std::unordered_set<raw_iterator, ox::iterator_hash<raw_iterator>> indices_flashed{};
-            std::queue<raw_iterator> dfs;
+        size_t width = 0;
+        size_t height = 0;
+        size_t stride = 0;
+        std::vector<uint8_t> energy;
+        std::vector<uint32_t> flashed_in;
+        std::vector<uint32_t> stack;
+        std::array<long, 8> offsets{};
+        uint32_t generation = 0;
 
-            for(auto& x : data | ox::ranges::views::iterators) {
-                if(++(*x) > 9) {
-                    dfs.push(x);
-                }
+        void charge(uint32_t i) {
+            if (flashed_in[i] < generation && ++energy[i] > 9) {
+                flashed_in[i] = generation;
+                energy[i] = 0;
+                stack.push_back(i);
             }
+        }
 
-            while (!dfs.empty()) {
-                raw_iterator current = dfs.front();
-                dfs.pop();
-                auto [in_iter, success] = indices_flashed.insert(current);
-                if (!success) {
-                    continue;
+    public:
+        explicit octopuses(const std::vector<std::string>& rows)
+            : width(rows.empty() ? 0 : rows.front().size()), height(rows.size()), stride(width + 2),
+              energy(stride * (height + 2), 0), flashed_in(stride * (height + 2), padding) {
+            for (size_t y = 0; y < height; ++y) {
+                for (size_t x = 0; x < width; ++x) {
+                    energy[(y + 1) * stride + x + 1] = uint8_t(rows[y][x] - '0');
+                    flashed_in[(y + 1) * stride + x + 1] = 0;
                 }
+            }
+            long s = long(stride);
+            offsets = {-s - 1, -s, -s + 1, -1, 1, s - 1, s, s + 1};
+            stack.reserve(width * height);
+        }
+
+        [[nodiscard]] size_t get_size() const { return width * height; }
+
+        // Raises every octopus by one and lets the flashes cascade; returns how many flashed
+        int next_step() {
+            ++generation;
+            for (uint32_t i = 0; i < energy.size(); ++i)
+                charge(i);
+            int flashes = 0;
+            while (!stack.empty()) {
+                uint32_t current = stack.back();
+                stack.pop_back();
+                ++flashes;
+                for (long offset : offsets)
+                    charge(uint32_t(long(current) + offset));
+            }
+            return flashes;
+        }
 
-                auto neighbour = neighbour_range(current);
-                for(auto index : neighbour | valid_index()) {
-                    if (++(*index) > 9)
-                        dfs.push(index);
+        // The first step on which every octopus flashes, or nothing if the grid falls into a loop without that
+        // happening. Loops are found by comparing every state with the one at the last power of two steps.
+        std::optional<long> first_synchronized_step() {
+            std::vector<uint8_t> seen = energy;
+            for (long step = 1, lap = 1;; ++step) {
+                if (size_t(next_step()) == get_size())
+                    return step;
+                if (energy == seen)
+                    return std::nullopt;
+                if (step == lap) {
+                    seen = energy;
+                    lap *= 2;
                 }
             }
+        }
 
-            for (auto x : indices_flashed) {
-                *x = 0;
+        void print_array() const {
+            for (size_t y = 1; y <= height; ++y) {
+                for (size_t x = 1; x <= width; ++x) {
+                    int i = energy[y * stride + x];
+                    myprintf("\033[%sm%4d\033[0m", i == 0 || i > 9 ? "31" : "0", i);
+                }
+                myprintf("\n");
             }
+        }
+    };
 
-            return indices_flashed.size();
+    // The grids are independent, so each worker takes the next unsolved one until none are left
+    std::vector<std::optional<long>> first_synchronized_steps(std::vector<octopuses> grids) {
+        std::vector<std::optional<long>> to_return(grids.size());
+        std::atomic<size_t> next = 0;
+        std::vector<std::thread> workers;
+        for (unsigned w = 0; w < std::max(1u, std::thread::hardware_concurrency()); ++w) {
+            workers.emplace_back([&] {
+                for (size_t i; (i = next++) < grids.size();)
+                    to_return[i] = grids[i].first_synchronized_step();
+            });
+        }
+        for (auto& worker : workers) {
+            worker.join();
         }
+        return to_return;
+    }
 
-        void print_array() {
-            leveled_foreach(
-                    [](int i) { myprintf("\033[%sm%4d\033[0m", i == 0 || i > 9 ? "31" : "0", i); },
-                    []() { myprintf("\n"); }
-            );
+    octopuses read_grid(puzzle_options filename) {
+        auto input = get_stream(filename);
+        std::vector<std::string> rows;
+        for (std::string s; std::getline(input, s) && !s.empty();)
+            rows.push_back(s);
+        return octopuses(rows);
+    }
+
+    // Every grid in the input, separated by blank lines
+    std::vector<octopuses> read_grids(puzzle_options filename) {
+        auto input = get_stream(filename);
+        std::vector<octopuses> to_return;
+        std::vector<std::string> rows;
+        for (std::string s; std::getline(input, s);) {
+            if (!s.empty()) {
+                rows.push_back(s);
+            } else if (!rows.empty()) {
+                to_return.emplace_back(rows);
+                rows.clear();
+            }
         }
-    };
+        if (!rows.empty())
+            to_return.emplace_back(rows);
+        return to_return;
+    }
 
     answertype puzzle1(puzzle_options filename) {
         int number_of_steps = 100;
-        octopuses o(get_stream<ox::line>(filename), [](char a) {return a - '0';});
-        auto scores = stdv::iota(0, number_of_steps) | stdv::transform([&o] (int) { return o.next_step(); });
-        auto steps = std::accumulate(scores.begin(), scores.end(), 0);
+        octopuses o = read_grid(filename);
+        int steps = 0;
+        for (int i = 0; i < number_of_steps; ++i)
+            steps += o.next_step();
         myprintf("Number of flashes after %d steps: %d\n", number_of_steps, steps);
         return steps;
     }
 
     answertype puzzle2(puzzle_options filename) {
-        octopuses o(get_stream<ox::line>(filename), [](char a) {return a - '0';});
-        auto scores = stdv::iota(1)
-                | stdv::transform([&o] (int a) { return std::make_pair(a, o.next_step()); })
-                | stdv::filter([&o](std::pair<int, int> a) { return std::size_t(a.second) == o.get_size(); })
-                | stdv::take(1);
-        auto flashes = (*scores.begin()).first;
-        myprintf("first point when all octopuses flash: %d\n", flashes);
+        auto steps = first_synchronized_steps(read_grids(filename));
+        for (size_t i = 1; i < steps.size(); ++i)
+            myprintf("grid %zu: all octopuses flash at step %ld\n", i + 1, steps[i].value_or(-1));
+
+        long flashes = steps.empty() ? -1 : steps.front().value_or(-1);
+        myprintf("first point when all octopuses flash: %ld\n", flashes);
         return flashes;
     }
 }
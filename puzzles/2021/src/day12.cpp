@@ -3,16 +3,13 @@
 #define DAY 12
 
 #include <vector>
-#include <set>
 #include <optional>
 #include <unordered_map>
 #include <ranges>
 #include <algorithm>
-
-#define pushpop(p, a, X) \
-p.push_back(a);\
-X;\
-p.pop_back();
+#include <bit>
+#include <cassert>
+#include <stdexcept>
 
 namespace aoc2021::day12 {
     class link : public std::pair<std::string, std::string> {};
@@ -24,55 +21,167 @@ namespace aoc2021::day12 {
         return in;
     }
 
+    // Caves are interned to indices with the small caves first, so a set of visited small caves is a bit mask over
+    // the low indices and neighbours are a bit mask per cave. Supports up to 64 caves.
     class graph {
-        using path = std::vector<std::string>;
-        std::unordered_multimap<std::string, std::string> links;
-
-        void _valid_paths_rec(path& p, std::vector<path>& out, int double_visited = true) {
-            std::string& curr = p.back();
-            auto [begin, end] = links.equal_range(curr);
-            for(const auto &[_, value] : stdr::subrange(begin, end)) {
-                if (value == "end") {
-                    pushpop(p, value, out.push_back(p))
-                } else if (std::isupper(value[0]) || std::find(p.begin(), p.end(), value) == p.end()) {
-                    pushpop(p, value, _valid_paths_rec(p, out, double_visited))
-                } else if (value != "start" && !double_visited ) {
-                    pushpop(p, value, _valid_paths_rec(p, out, true))
-                }
+    public:
+        using cave = int;
+
+    private:
+        std::vector<std::string> names;
+        std::vector<uint64_t> neighbours;
+        cave small_count = 0;
+        cave start = 0;
+        cave end = 0;
+
+        [[nodiscard]] bool is_small(cave c) const { return c < small_count; }
+
+        // Paths from c to the end, given the small caves already visited and whether a small cave was visited twice
+        uint64_t count_from(cave c, uint64_t visited, bool double_used,
+                            std::unordered_map<uint64_t, uint64_t>& memo) const {
+            if (c == end)
+                return 1;
+            uint64_t key = (visited << 7) | uint64_t(c) << 1 | double_used;
+            if (auto found = memo.find(key); found != memo.end())
+                return found->second;
+
+            uint64_t total = 0;
+            for (uint64_t next = neighbours[size_t(c)]; next != 0; next &= next - 1) {
+                cave n = std::countr_zero(next);
+                uint64_t bit = uint64_t(1) << n;
+                if (!is_small(n))
+                    total += count_from(n, visited, double_used, memo);
+                else if (!(visited & bit))
+                    total += count_from(n, visited | bit, double_used, memo);
+                else if (!double_used && n != start)
+                    total += count_from(n, visited, true, memo);
             }
+            memo.emplace(key, total);
+            return total;
         }
 
     public:
         template<stdr::range R>
         explicit graph(R& r) {
-            for (const link& l : r) {
-                links.emplace(l.first, l.second);
-                links.emplace(l.second, l.first);
+            std::vector<link> links(stdr::begin(r), stdr::end(r));
+            for (const link& l : links) {
+                names.push_back(l.first);
+                names.push_back(l.second);
             }
+            stdr::sort(names);
+            names.erase(stdr::unique(names).begin(), names.end());
+            small_count = cave(stdr::stable_partition(names, [](const std::string& s) { return std::islower(s[0]); })
+                                       .begin() - names.begin());
+            if (names.size() > 64 || small_count > 57)
+                throw std::runtime_error("cave graphs are limited to 64 caves, 57 of them small");
+
+            auto index = [this](const std::string& name) { return cave(stdr::find(names, name) - names.begin()); };
+            neighbours.resize(names.size());
+            for (const link& l : links) {
+                neighbours[size_t(index(l.first))] |= uint64_t(1) << index(l.second);
+                neighbours[size_t(index(l.second))] |= uint64_t(1) << index(l.first);
+            }
+            start = index("start");
+            end = index("end");
         }
 
-        std::vector<path> get_valid_paths(bool with_return = false) {
-            path p{"start"};
-            p.reserve(links.size() * 3);
-            std::vector<path> out;
-            _valid_paths_rec(p, out, !with_return);
-            return out;
+        // Counts the paths without walking them: the paths onwards from a cave only depend on the set of small caves
+        // visited so far and on whether the double visit is spent, so each such state is counted once
+        [[nodiscard]] uint64_t count_valid_paths(bool with_return = false) const {
+            std::unordered_map<uint64_t, uint64_t> memo;
+            return count_from(start, uint64_t(1) << start, !with_return, memo);
         }
+
+        // Walks the valid paths one at a time, for callers that need the paths themselves. Only the current path is
+        // kept, as a stack of caves together with the neighbours each of them has left to try.
+        class path_walker {
+            struct frame {
+                cave c;
+                uint64_t pending;
+                bool double_used;
+                bool marked;
+            };
+
+            const graph& g;
+            std::vector<frame> stack;
+            uint64_t visited;
+
+        public:
+            path_walker(const graph& g, bool with_return)
+                : g(g), stack{{g.start, g.neighbours[size_t(g.start)], !with_return, true}},
+                  visited(uint64_t(1) << g.start) {}
+
+            // Advances to the next complete path, returning false once there are none left
+            bool next() {
+                while (!stack.empty()) {
+                    frame& top = stack.back();
+                    if (top.pending == 0) {
+                        if (top.marked)
+                            visited &= ~(uint64_t(1) << top.c);
+                        stack.pop_back();
+                        continue;
+                    }
+                    cave n = std::countr_zero(top.pending);
+                    top.pending &= top.pending - 1;
+                    uint64_t bit = uint64_t(1) << n;
+                    bool double_used = top.double_used;
+                    if (n == g.end)
+                        return true;
+                    if (!g.is_small(n)) {
+                        stack.push_back({n, g.neighbours[size_t(n)], double_used, false});
+                    } else if (!(visited & bit)) {
+                        visited |= bit;
+                        stack.push_back({n, g.neighbours[size_t(n)], double_used, true});
+                    } else if (!double_used && n != g.start) {
+                        stack.push_back({n, g.neighbours[size_t(n)], true, false});
+                    }
+                }
+                return false;
+            }
+
+            // The names along the current path, from start to end
+            [[nodiscard]] std::vector<std::string> path() const {
+                std::vector<std::string> to_return;
+                for (const frame& f : stack)
+                    to_return.push_back(g.names[size_t(f.c)]);
+                to_return.push_back(g.names[size_t(g.end)]);
+                return to_return;
+            }
+        };
+
+        [[nodiscard]] path_walker walk_valid_paths(bool with_return = false) const { return {*this, with_return}; }
     };
 
+    // Debug builds also walk the paths one at a time when there are few enough of them, so the counting and the
+    // walking cannot drift apart
+    void check_walked_paths([[maybe_unused]] const graph& g, [[maybe_unused]] bool with_return,
+                            [[maybe_unused]] uint64_t paths) {
+#ifndef NDEBUG
+        constexpr uint64_t walk_limit = 1 << 20;
+        if (paths > walk_limit)
+            return;
+        uint64_t walked = 0;
+        for (auto walker = g.walk_valid_paths(with_return); walker.next() && walked <= walk_limit;)
+            ++walked;
+        assert(walked == paths);
+#endif
+    }
+
     answertype puzzle1(puzzle_options filename) {
         auto input = get_stream<link>(filename);
         graph g(input);
-        auto paths = g.get_valid_paths();
-        myprintf("Number of unique paths is: %zu\n", paths.size());
-        return paths.size();
+        uint64_t paths = g.count_valid_paths();
+        check_walked_paths(g, false, paths);
+        myprintf("Number of unique paths is: %lu\n", paths);
+        return paths;
     }
 
     answertype puzzle2(puzzle_options filename) {
         auto input = get_stream<link>(filename);
         graph g(input);
-        auto paths = g.get_valid_paths(true);
-        myprintf("Number of unique paths is: %zu\n", paths.size());
-        return paths.size();
+        uint64_t paths = g.count_valid_paths(true);
+        check_walked_paths(g, true, paths);
+        myprintf("Number of unique paths is: %lu\n", paths);
+        return paths;
     }
 }
@@ -3,61 +3,111 @@
 #define DAY 13
 
 #include <vector>
-#include <unordered_set>
-#include <set>
-#include <queue>
-#include <numeric>
 #include <optional>
-#include <concepts>
 #include <algorithm>
+#include <array>
+#include <bit>
 
 namespace aoc2021::day13 {
     struct fold : public std::pair<char, int> {};
 
+    constexpr uint64_t reverse_bits(uint64_t w) {
+        w = (w >> 1 & 0x5555555555555555) | (w & 0x5555555555555555) << 1;
+        w = (w >> 2 & 0x3333333333333333) | (w & 0x3333333333333333) << 2;
+        w = (w >> 4 & 0x0F0F0F0F0F0F0F0F) | (w & 0x0F0F0F0F0F0F0F0F) << 4;
+        return std::byteswap(w);
+    }
+
+    // The letters of the puzzle font, 4 wide and 6 tall, one row per nibble with the top row highest and the
+    // leftmost column in the highest bit of each nibble
+    constexpr std::array<std::pair<uint32_t, char>, 18> glyphs{{
+            {0x699F99, 'A'}, {0xE9E99E, 'B'}, {0x698896, 'C'}, {0xF8E88F, 'E'}, {0xF8E888, 'F'}, {0x698B97, 'G'},
+            {0x99F999, 'H'}, {0x722227, 'I'}, {0x311196, 'J'}, {0x9ACAA9, 'K'}, {0x88888F, 'L'}, {0x699996, 'O'},
+            {0xE99E88, 'P'}, {0xE99EA9, 'R'}, {0x78861E, 'S'}, {0x999996, 'U'}, {0xF1248F, 'Z'}, {0x000000, ' '},
+    }};
+
+    // The sheet as rows of bits, `stride` words per row. Folding up ORs every row below the crease into its mirror
+    // image above it; folding left ORs each row with its own bit reversal, shifted so the crease maps onto itself.
+    // Either way every fold is one pass over the rows it keeps.
     struct paper {
-        using point = std::pair<int, int>;
-        std::set<point> points;
-        point dimensions;
-
-        void foldY(int cress) {
-            std::set<point> new_set;
-            for (point p : points) {
-                if (p.second < cress)
-                    new_set.insert(p);
-                if (p.second > cress)
-                    new_set.insert({p.first, 2 * cress - p.second});
+        std::vector<uint64_t> bits;
+        size_t width = 0;
+        size_t height = 0;
+        size_t stride = 0;
+
+        [[nodiscard]] uint64_t* row(size_t y) { return bits.data() + y * stride; }
+        [[nodiscard]] const uint64_t* row(size_t y) const { return bits.data() + y * stride; }
+
+        [[nodiscard]] bool get(size_t x, size_t y) const {
+            return x < width && y < height && (row(y)[x / 64] >> (x % 64) & 1);
+        }
+
+        // Folds that reach past the opposite edge lose the dots that would land outside the sheet
+        void foldY(size_t cress) {
+            for (size_t y = cress + 1; y < height && y <= 2 * cress; ++y) {
+                const uint64_t* from = row(y);
+                uint64_t* to = row(2 * cress - y);
+                for (size_t w = 0; w < stride; ++w)
+                    to[w] |= from[w];
             }
-            points = new_set;
-            dimensions.second = cress;
+            height = std::min(height, cress);
+            bits.resize(height * stride);
         }
 
-        void foldX(int cress) {
-            std::set<point> new_set;
-            for (point p : points) {
-                if (p.first < cress)
-                    new_set.insert(p);
-                if (p.first > cress)
-                    new_set.insert({2 * cress - p.first, p.second});
+        void foldX(size_t cress) {
+            if (cress >= width) {
+                return;
             }
-            points = new_set;
-            dimensions.first = cress;
+            size_t new_stride = (cress + 63) / 64;
+            // Bit x of the reversed row is bit (64 * stride - 1 - x) of the row, and has to move to 2 * cress - x
+            long shift = long(64 * stride) - 1 - 2 * long(cress);
+            std::vector<uint64_t> reversed(stride);
+            auto reversed_at = [&reversed](long offset) {
+                long word = offset >= 0 ? offset / 64 : (offset - 63) / 64;
+                long bit = offset - 64 * word;
+                auto get = [&reversed](long i) {
+                    return i >= 0 && i < long(reversed.size()) ? reversed[size_t(i)] : 0;
+                };
+                return bit == 0 ? get(word) : get(word) >> bit | get(word + 1) << (64 - bit);
+            };
+            uint64_t last_mask = cress % 64 == 0 ? ~uint64_t(0) : (uint64_t(1) << (cress % 64)) - 1;
+
+            for (size_t y = 0; y < height; ++y) {
+                const uint64_t* from = row(y);
+                for (size_t w = 0; w < stride; ++w)
+                    reversed[w] = reverse_bits(from[stride - 1 - w]);
+                uint64_t* to = bits.data() + y * new_stride;
+                for (size_t w = 0; w < new_stride; ++w) {
+                    uint64_t folded = from[w] | reversed_at(long(64 * w) + shift);
+                    to[w] = w + 1 == new_stride ? folded & last_mask : folded;
+                }
+            }
+            width = cress;
+            stride = new_stride;
+            bits.resize(height * stride);
         }
+
     public:
         explicit paper(std::istream& in) {
+            std::vector<std::pair<size_t, size_t>> points;
             std::string s;
-            while(std::getline(in, s) && !s.empty()) {
-                point p;
-                std::sscanf(s.c_str(), "%d,%d", &p.first, &p.second);
-                points.insert(p);
+            while (std::getline(in, s) && !s.empty()) {
+                size_t x = 0, y = 0;
+                std::sscanf(s.c_str(), "%zu,%zu", &x, &y);
+                points.emplace_back(x, y);
+                width = std::max(width, x + 1);
+                height = std::max(height, y + 1);
             }
-            dimensions.first = stdr::max(points | stdv::transform(&point::first)) + 1;
-            dimensions.second = stdr::max(points | stdv::transform(&point::second)) + 1;
+            stride = (width + 63) / 64;
+            bits.resize(height * stride);
+            for (auto [x, y] : points)
+                row(y)[x / 64] |= uint64_t(1) << (x % 64);
         }
 
-        void print_paper(int limit = 100) {
-            for(int j : stdv::iota(0, std::min(dimensions.second, limit))) {
-                for (int i : stdv::iota(0,  std::min(dimensions.first, limit))) {
-                    myprintf("%s", points.contains({i, j}) ? "\033[41m \033[0m" : " ");
+        void print_paper(size_t limit = 100) const {
+            for (size_t j = 0; j < std::min(height, limit); ++j) {
+                for (size_t i = 0; i < std::min(width, limit); ++i) {
+                    myprintf("%s", get(i, j) ? "\033[41m \033[0m" : " ");
                 }
                 myprintf("\n");
             }
@@ -65,13 +115,31 @@ namespace aoc2021::day13 {
 
         void fold(fold f) {
             if (f.first == 'y')
-                foldY(f.second);
+                foldY(size_t(f.second));
             else
-                foldX(f.second);
+                foldX(size_t(f.second));
         }
 
-        auto point_count() {
-            return points.size();
+        [[nodiscard]] size_t point_count() const {
+            size_t count = 0;
+            for (uint64_t w : bits)
+                count += size_t(std::popcount(w));
+            return count;
+        }
+
+        // Reads the letters in the top six rows, five columns apart; unknown shapes come out as '?'
+        [[nodiscard]] std::string read_letters() const {
+            std::string to_return;
+            for (size_t left = 0; left < width; left += 5) {
+                uint32_t code = 0;
+                for (size_t y = 0; y < 6; ++y) {
+                    for (size_t x = left; x < left + 4; ++x)
+                        code = code << 1 | get(x, y);
+                }
+                auto found = stdr::find(glyphs, code, &std::pair<uint32_t, char>::first);
+                to_return += found != glyphs.end() ? found->second : '?';
+            }
+            return to_return;
         }
     };
 
@@ -96,7 +164,10 @@ namespace aoc2021::day13 {
         for (auto f : input) {
             p.fold(f);
         }
-        p.print_paper();
-        return {};
+        std::string letters = p.read_letters();
+        if (letters.contains('?'))
+            p.print_paper();
+        myprintf("The code is %s\n", letters.c_str());
+        return letters;
     }
 }
@@ -1,71 +1,63 @@
 #include <cassert>
-#include <set>
-#include <map>
-#include <unordered_set>
 #include <algorithm>
-#include <limits>
-#include <queue>
-#include <cmath>
-#include <numeric>
-#include "ox/grid.h"
-#include "ox/graph.h"
 #include "../../../common.h"
+#include "../../../grid_search.h"
 
 #define DAY 15
 
 namespace aoc2021::day15 {
-    class grid : public ox::grid<int> {
-        using ox::grid<int>::grid;
+    // The full map is the input tiled `multiply` times in both directions, with every tile step adding one
+    // to the risk (wrapping from 9 back to 1). Risks are computed from the input tile on demand.
+    class grid {
+        std::vector<uint8_t> data;
+        size_t width = 0;
+        size_t height = 0;
+        size_t multiply;
+
+        [[nodiscard]] int risk(size_t index) const {
+            size_t x = index % (width * multiply), y = index / (width * multiply);
+            int base = data[(y % height) * width + x % width];
+            return static_cast<int>((base - 1 + x / width + y / height) % 9 + 1);
+        }
 
     public:
-        explicit grid(std::istream& in, int multiply) {
+        grid(std::istream& in, size_t multiply) : multiply(multiply) {
             std::string s;
             while (std::getline(in, s)) {
-                for (int offset : stdv::iota(0, multiply)) {
-                    std::transform(s.begin(), s.end(), std::back_inserter(data), [offset](char a) {
-                        return (a - '0' + offset) % 10 + (a - '0' + offset) / 10;
-                    });
-                }
+                width = s.size();
+                std::transform(s.begin(), s.end(), std::back_inserter(data), [](char a) { return a - '0'; });
+                ++height;
             }
-            data.reserve(multiply * data.size());
-            auto initial_end = data.end();
-            for (int offset : stdv::iota(1, multiply)) {
-                std::transform(data.begin(), initial_end, std::back_inserter(data), [offset](int a) {
-                    return (a + offset) % 10 + (a + offset) / 10;
-                });
-            }
-            set_width(s.size() * multiply);
         }
 
-        auto find_path() {
-            return ox::dikstra(
-                   data.begin(), data.end() - 1,
-                   [this](auto curr) -> std::vector<std::pair<raw_iterator, int>> {
-                       auto neighbours = cardinal_neighbour_range(curr);
-                       auto n = neighbours
-                              | valid_index()
-                              | stdv::transform([](const auto& x) -> std::pair<raw_iterator, int> {
-                                    return std::make_pair(x, *x);
-                                });
-                       return std::vector(n.begin(), n.end());
-                   },
-                   [](...) { return 0; },
-                   ox::range_iterator_hash<decltype(data)>());
+        long find_path() {
+            size_t full_width = width * multiply, full_height = height * multiply;
+            size_t end = full_width * full_height - 1;
+            auto risk = dial_shortest_path(
+                    full_width,
+                    full_height,
+                    0,
+                    9,
+                    [this](size_t, size_t to) { return this->risk(to); },
+                    [end](size_t index) { return index == end; });
+            assert(risk);
+            return *risk;
         }
     };
 
     answertype puzzle1(puzzle_options filename) {
-        grid g(get_stream<ox::line>(filename), [](char a) mutable { return a - '0'; });
-        auto [path, risk] = g.find_path();
-        myprintf("Total Risk = %d\n", risk);
+        auto input = get_stream<ox::line>(filename);
+        grid g(input, 1);
+        long risk = g.find_path();
+        myprintf("Total Risk = %ld\n", risk);
         return risk;
     }
 
     answertype puzzle2(puzzle_options filename) {
         auto input = get_stream<ox::line>(filename);
         grid g(input, 5);
-        auto [path, risk] = g.find_path();
-        myprintf("Total Risk = %d\n", risk);
+        long risk = g.find_path();
+        myprintf("Total Risk = %ld\n", risk);
         return risk;
     }
 } // namespace aoc2021::day15
@@ -1,198 +1,181 @@
 #include "../../../common.h"
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <random>
 #include <vector>
-#include <bitset>
-#include <iterator>
-#include <variant>
-#include <numeric>
-#include <functional>
 
 #define DAY 16
 
 namespace aoc2021::day16 {
-    struct packet;
-    struct Literal {
-        std::vector<bool> number;
-    };
-    struct Operator {
-        int length;
-        std::vector<packet> packets;
-        bool lengthId;
+    enum packet_type { SUM, PRODUCT, MINIMUM, MAXIMUM, LITERAL, GREATER, LESS, EQUAL };
+
+    // Reads big-endian bit fields of up to 57 bits with a single unaligned 64-bit load
+    struct bit_reader {
+        std::vector<uint8_t> bytes;
+        size_t position = 0;
+
+        explicit bit_reader(std::string_view hex) : bytes(hex.size() / 2 + 1 + sizeof(uint64_t)) {
+            for (size_t i = 0; i < hex.size(); ++i) {
+                char c = hex[i];
+                auto nibble = static_cast<uint8_t>(c <= '9' ? c - '0' : (c & ~0x20) - 'A' + 10);
+                bytes[i / 2] |= static_cast<uint8_t>(i % 2 ? nibble : nibble << 4);
+            }
+        }
+
+        unsigned long read(int bits) {
+            uint64_t word;
+            std::memcpy(&word, bytes.data() + position / 8, sizeof(word));
+            if constexpr (std::endian::native == std::endian::little)
+                word = std::byteswap(word);
+            word <<= position % 8;
+            position += static_cast<size_t>(bits);
+            return word >> (64 - bits);
+        }
     };
-    struct packet {
-        int version;
-        int type;
-        std::variant<Literal, Operator> body;
+
+    struct packet_result {
+        long version_sum;
+        long value;
     };
 
-    template <std::forward_iterator T>
-    unsigned long parse_int_from_bool(T begin, T end) {
-        return std::accumulate(begin, end, 0ul,
-               [](auto acc, auto bit) { return (acc << 1) | bit; });
+    long combine(int type, long acc, long value) {
+        switch (type) {
+            case SUM: return acc + value;
+            case PRODUCT: return acc * value;
+            case MINIMUM: return std::min(acc, value);
+            case MAXIMUM: return std::max(acc, value);
+            case GREATER: return acc > value;
+            case LESS: return acc < value;
+            case EQUAL: return acc == value;
+            default: return 0;
+        }
     }
 
-    template <std::forward_iterator T>
-    std::pair<packet, T> parse_packet(T current_position);
-
-    template <std::forward_iterator T>
-    std::pair<Literal, T> parse_literal(T current_position) {
-        Literal l;
-        bool cont = true;
-        while(cont) {
-            cont = *current_position++;
-            std::copy(current_position, current_position + 4, std::back_inserter(l.number));
-            current_position += 4;
+    // Version sum and value are both accumulated while the packet is read, no tree is built
+    packet_result decode_packet(bit_reader& reader) {
+        auto version = static_cast<long>(reader.read(3));
+        auto type = static_cast<int>(reader.read(3));
+
+        if (type == LITERAL) {
+            long value = 0;
+            unsigned long group;
+            do {
+                group = reader.read(5);
+                value = (value << 4) | static_cast<long>(group & 0xF);
+            } while (group & 0x10);
+            return {version, value};
         }
-        return {l, current_position};
-    }
 
-    template <std::forward_iterator T>
-    std::pair<Operator, T> parse_operator(T current_position) {
-        Operator o;
-        o.lengthId = *current_position++;
-        if (o.lengthId) {
-            o.length = parse_int_from_bool(current_position, current_position + 11);
-            current_position += 11;
-            for ([[maybe_unused]] int i : stdv::iota(0, o.length)) {
-                auto [packet, new_position] = parse_packet(current_position);
-                o.packets.push_back(std::move(packet));
-                current_position = new_position;
+        packet_result result{version, 0};
+        bool first = true;
+        auto add_sub_packet = [&] {
+            auto [sub_version, sub_value] = decode_packet(reader);
+            result.version_sum += sub_version;
+            result.value = first ? sub_value : combine(type, result.value, sub_value);
+            first = false;
+        };
+
+        if (reader.read(1)) {
+            for (unsigned long count = reader.read(11); count > 0; --count) {
+                add_sub_packet();
             }
         } else {
-            o.length = parse_int_from_bool(current_position, current_position + 15);
-            current_position += 15;
-            auto endpoint = current_position + o.length;
-            while (current_position != endpoint) {
-                auto [packet, new_position] = parse_packet(current_position);
-                o.packets.push_back(std::move(packet));
-                current_position = new_position;
+            unsigned long length = reader.read(15);
+            for (size_t end = reader.position + length; reader.position < end;) {
+                add_sub_packet();
             }
         }
-        return {o, current_position};
+        return result;
     }
 
-    template <std::forward_iterator T>
-    std::pair<packet, T> parse_packet(T current_position) {
-        packet p;
-        p.version = parse_int_from_bool(current_position, current_position + 3);
-        current_position += 3;
-        p.type = parse_int_from_bool(current_position, current_position + 3);
-        current_position += 3;
-        if (p.type == 4) {
-            auto [literal, new_position] = parse_literal(current_position);
-            p.body = literal;
-            current_position = new_position;
-        } else {
-            auto [op, new_position] = parse_operator(current_position);
-            p.body = op;
-            current_position = new_position;
-        }
-        return {p, current_position};
-    }
+    struct bit_writer {
+        std::vector<bool> bits;
 
-    long evaluate_packet(const packet& p);
-
-    char type_to_op(int i) {
-        switch (i) {
-            case 0: return '+';
-            case 1: return '*';
-            case 2: return '_';
-            case 3: return '^';
-            case 4: return '#';
-            case 5: return '>';
-            case 6: return '<';
-            case 7: return '=';
-            default: return 0;
+        void write(unsigned long value, int count) {
+            for (int i = count - 1; i >= 0; --i) {
+                bits.push_back((value >> i) & 1);
+            }
         }
-    }
 
-    std::function<long(long, packet)> type_to_reduce(int i) {
-        switch (i) {
-            case 0: return [](long i, const packet& p) { return i + evaluate_packet(p); };
-            case 1: return [](long i, const packet& p) { return i * evaluate_packet(p); };
-            case 2: return [](long i, const packet& p) { return std::min(i, evaluate_packet(p)); };
-            case 3: return [](long i, const packet& p) { return std::max(i, evaluate_packet(p)); };
-            case 5: return [](long i, const packet& p) { return i > evaluate_packet(p); };
-            case 6: return [](long i, const packet& p) { return i < evaluate_packet(p); };
-            case 7: return [](long i, const packet& p) { return i == evaluate_packet(p); };
-            default: return [](long, const packet&) { return 0l; };
+        void append(const bit_writer& other) { bits.insert(bits.end(), other.bits.begin(), other.bits.end()); }
+
+        [[nodiscard]] std::string to_hex() const {
+            std::string to_return;
+            for (size_t i = 0; i < bits.size(); i += 4) {
+                int nibble = 0;
+                for (size_t j = i; j < i + 4; ++j) {
+                    nibble = (nibble << 1) | (j < bits.size() && bits[j]);
+                }
+                to_return.push_back("0123456789ABCDEF"[nibble]);
+            }
+            return to_return;
         }
-    }
+    };
 
-    long evaluate_literal(const Literal& l) {
-        return parse_int_from_bool(l.number.begin(), l.number.end());
-    }
-    long evaluate_operator(const Operator& o, int type) {
-        return std::accumulate(std::next(o.packets.begin()), o.packets.end(), evaluate_packet(o.packets.front()), type_to_reduce(type));
-    }
-    long evaluate_packet(const packet& p) {
-        if (p.type == 4) {
-            return evaluate_literal(std::get<0>(p.body));
-        } else {
-            return evaluate_operator(std::get<1>(p.body), p.type);
+    // Random transmission with about `budget` packets, using only operators whose value cannot overflow
+    void generate_packet(bit_writer& out, long budget, std::mt19937& gen) {
+        out.write(gen() % 8, 3);
+        if (budget <= 2) {
+            out.write(LITERAL, 3);
+            unsigned long value = gen() % (1ul << 20);
+            for (int shift = 16; shift > 0; shift -= 4) {
+                out.write(0x10 | ((value >> shift) & 0xF), 5);
+            }
+            out.write(value & 0xF, 5);
+            return;
         }
-    }
 
-    void print_packet(const packet& p, int indent = 0);
-    void print_literal(const Literal& l) {
-        myprintf("(%lu)", parse_int_from_bool(l.number.begin(), l.number.end()));
-    }
-    void print_operator(const Operator& o, int indent = 0) {
-        for (packet p : o.packets) {
-            myprintf("\n");
-            print_packet(p, indent + 1);
+        constexpr std::array operators{SUM, MINIMUM, MAXIMUM, GREATER, LESS, EQUAL};
+        int type = operators[gen() % operators.size()];
+        long children = type >= GREATER ? 2 : std::min<long>(budget - 1, 2 + gen() % 7);
+        bit_writer body;
+        for (long i = 0; i < children; ++i) {
+            generate_packet(body, (budget - 1) / children, gen);
         }
-    }
-    void print_packet(const packet& p, int indent) {
-        char temp[10];
-        sprintf(temp, "%%%ds", indent * 4);
-        myprintf(temp, "");
-        myprintf("<version = %d, type = '%c'> ", p.version, type_to_op(p.type));
-        if (p.type == 4) {
-            print_literal(std::get<0>(p.body));
+
+        out.write(static_cast<unsigned long>(type), 3);
+        if (body.bits.size() < (1ul << 15)) {
+            out.write(0, 1);
+            out.write(body.bits.size(), 15);
         } else {
-            print_operator(std::get<1>(p.body), indent);
+            out.write(1, 1);
+            out.write(static_cast<unsigned long>(children), 11);
         }
+        out.append(body);
     }
 
-    long add_packet_version(const packet& p);
-    long add_operator_version(const Operator& o) {
-        return std::accumulate(o.packets.begin(), o.packets.end(), 0l, [](long acc, const packet& p) { return acc + add_packet_version(p); });
-    }
-    long add_packet_version(const packet& o) {
-        int acc = o.version;
-        if (o.type != 4) {
-            acc += add_operator_version(std::get<1>(o.body));
+    std::string get_transmission(puzzle_options filename) {
+        if (auto size = benchmark_size(filename)) {
+            std::mt19937 gen(16);
+            bit_writer out;
+            generate_packet(out, *size, gen);
+            return out.to_hex();
         }
-        return acc;
+        auto input = get_stream<char>(filename);
+        return {input.begin(), input.end()};
     }
 
-    template <std::ranges::range R>
-    std::vector<bool> parse_character(R& input) {
-        std::vector<bool> b;
-        for (char c : input) {
-            char str[2] = {c, 0};
-            long num = strtol(str, nullptr, 16);
-            auto x = stdv::iota(0u, 4u) | stdv::transform([num](int i) { return static_cast<bool>((1u << i) & num); }) | stdv::reverse;
-            std::copy(x.begin(), x.end(), std::back_inserter(b));
-        }
-        return b;
+    packet_result decode(puzzle_options filename) {
+        std::string hex = get_transmission(filename);
+        auto start = std::chrono::steady_clock::now();
+        bit_reader reader(hex);
+        auto result = decode_packet(reader);
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        if (benchmark_size(filename))
+            myprintf("Decoded %zu hex digits in %.3f ms\n", hex.size(), elapsed.count());
+        return result;
     }
 
     answertype puzzle1(puzzle_options filename) {
-        auto input = get_stream<char>(filename);
-        std::vector<bool> b = parse_character(input);
-        auto [packet, end] = parse_packet(b.begin());
-        long result = add_packet_version(packet);
+        long result = decode(filename).version_sum;
         myprintf("The total version count is: %ld\n", result);
         return result;
     }
 
     answertype puzzle2(puzzle_options filename) {
-        auto input = get_stream<char>(filename);
-        std::vector<bool> b = parse_character(input);
-        auto [packet, end] = parse_packet(b.begin());
-        long result = evaluate_packet(packet);
+        long result = decode(filename).value;
         myprintf("The total version count is: %ld\n", result);
         return result;
     }
-}
\ No newline at end of file
+}
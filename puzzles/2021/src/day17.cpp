@@ -1,6 +1,8 @@
 #include "../../../common.h"
 #include "ox/math.h"
+#include <bit>
 #include <cassert>
+#include <cmath>
 #include <vector>
 
 #define DAY 17
@@ -25,40 +27,86 @@ namespace aoc2021::day17 {
         return ox::triangle_sum(vy);
     }
 
-    bool is_valid_xy(target_area t, int init_x, int init_y) {
-        int x = 0, y = 0, vx = init_x, vy = init_y;
-        for([[maybe_unused]] int step = 0; ; step++) {
-            x += vx;
-            y += vy;
-            vx = std::max(0, vx - 1);
-            vy -= 1;
-
-            if (x > t.first.second)
-                return false;
-            if (y < t.second.second)
-                return false;
-
-            if (x >= t.first.first && y <= t.second.first)
-                return true;
-        }
+    // Inclusive, and empty when lo > hi
+    struct speed_range {
+        long lo;
+        long hi;
+    };
+
+    long floor_div(long a, long b) { return a / b - (a % b != 0 && a < 0); }
+    long ceil_div(long a, long b) { return -floor_div(-a, b); }
+
+    // The largest n with triangle_sum(n) <= value
+    long inverse_triangle(long value) {
+        if (value < 0)
+            return -1;
+        auto n = long((std::sqrt(8.0 * double(value) + 1) - 1) / 2);
+        while (ox::triangle_sum(n + 1) <= value)
+            ++n;
+        while (ox::triangle_sum(n) > value)
+            --n;
+        return n;
+    }
+
+    // Initial speeds that are between lo and hi after exactly `steps` steps, while slowing down by one every step:
+    // steps * v - triangle_sum(steps - 1)
+    speed_range speeds_after(long lo, long hi, long steps) {
+        long slowdown = ox::triangle_sum(steps - 1);
+        return {ceil_div(lo + slowdown, steps), floor_div(hi + slowdown, steps)};
     }
 
-    std::vector<std::pair<int, int>> get_all_valid_starts(target_area t) {
-        int y = max_initial_y(t);
-        std::vector<std::pair<int, int>> to_return;
-        for (int init_x : stdv::iota(0, t.first.second+1)) {
-            for (int init_y : stdv::iota(-(y + 1), y + 1)) {
-                if (is_valid_xy(t, init_x, init_y))
-                    to_return.emplace_back(init_x, init_y);
+    // For every step count the initial vertical speeds that are in the target at that step form one range, and so
+    // do the horizontal speeds that are still moving. The horizontal speeds that have come to rest inside the
+    // target by then are one more range, found by inverting the triangle numbers. Every pair of an x and y speed
+    // that hit at the same step is marked in a bitmap with a row per x speed, so pairs that hit at several steps
+    // count once.
+    long count_valid_starts(target_area t) {
+        long x_min = t.first.first, x_max = t.first.second;
+        long y_min = t.second.second, y_max = t.second.first;
+        // A probe thrown up at vy comes back down through y = 0 at speed -(vy + 1), so faster ones overshoot
+        speed_range vys{y_min, -y_min - 1};
+        long max_steps = -2 * y_min;
+        speed_range resting{inverse_triangle(x_min - 1) + 1, std::min(x_max, inverse_triangle(x_max))};
+
+        long words = (vys.hi - vys.lo) / 64 + 1;
+        std::vector<uint64_t> hits(size_t((x_max + 1) * words));
+        auto mark = [&](long vx_lo, long vx_hi, speed_range vy) {
+            for (long vx = std::max(0l, vx_lo); vx <= vx_hi; ++vx) {
+                uint64_t* row = hits.data() + vx * words;
+                for (long bit = vy.lo - vys.lo; bit <= vy.hi - vys.lo;) {
+                    long end = std::min(vy.hi - vys.lo, bit | 63);
+                    uint64_t run = end - bit == 63 ? ~uint64_t(0) : ((uint64_t(1) << (end - bit + 1)) - 1);
+                    row[bit / 64] |= run << (bit % 64);
+                    bit = end + 1;
+                }
             }
+        };
+
+        for (long steps = 1; steps <= max_steps; ++steps) {
+            speed_range vy = speeds_after(y_min, y_max, steps);
+            vy = {std::max(vy.lo, vys.lo), std::min(vy.hi, vys.hi)};
+            if (vy.lo > vy.hi)
+                continue;
+            speed_range moving = speeds_after(x_min, x_max, steps);
+            mark(std::max(moving.lo, steps), std::min(moving.hi, x_max), vy);
+            mark(resting.lo, std::min(resting.hi, steps - 1), vy);
         }
-        return to_return;
+
+        long count = 0;
+        for (uint64_t w : hits)
+            count += std::popcount(w);
+        return count;
     }
 
-    answertype puzzle1(puzzle_options filename) {
+    target_area get_target(puzzle_options filename) {
         target_area t;
         auto input = get_stream<target_area>(filename);
         input >> t;
+        return t;
+    }
+
+    answertype puzzle1(puzzle_options filename) {
+        target_area t = get_target(filename);
 
         int initial_speed = max_initial_y(t);
         int highest = height_from_initial_y(initial_speed);
@@ -67,12 +115,10 @@ namespace aoc2021::day17 {
     }
 
     answertype puzzle2(puzzle_options filename) {
-        target_area t;
-        auto input = get_stream<target_area>(filename);
-        input >> t;
+        target_area t = get_target(filename);
 
-        std::vector<std::pair<int, int>> initial_speeds = get_all_valid_starts(t);
-        myprintf("The number of valid initial speeds are %zu\n", initial_speeds.size());
-        return initial_speeds.size();
+        long initial_speeds = count_valid_starts(t);
+        myprintf("The number of valid initial speeds are %ld\n", initial_speeds);
+        return initial_speeds;
     }
 } // namespace aoc2021::day17
@@ -1,114 +1,123 @@
 #include "../../../common.h"
-#include "ox/tree.h"
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <ranges>
-#include <sstream>
-#include <algorithm>
-#include <cmath>
+#include <thread>
 #include "ox/debug.h"
-#include "ox/ranges.h"
 
 #define DAY 18
 
 namespace aoc2021::day18 {
-    using snail_number_node = ox::binary_tree_node<std::optional<int>>;
-    using snail_number = ox::binary_tree<std::optional<int>>;
-
-    snail_number_node read_snail_number(std::istream& in) {
-        snail_number_node to_return;
-        int c = in.peek();
-        assert(c == '[' || ('0' <= c && c <= '9'));
-        if (c == '[') {
-            in.get();
-            to_return.emplace_left(read_snail_number(in));
-            in.get();
-            to_return.emplace_right(read_snail_number(in));
-            in.get();
-        } else if ('0' <= c && c <= '9') {
-            int i;
-            in >> i;
-            to_return.value = i;
+    // A snailfish number is stored as its regular numbers from left to right, each with the number of
+    // pairs enclosing it. A reduced number is at most 4 deep (16 values), so the sum of two fits in 32.
+    struct leaf {
+        int value;
+        int depth;
+    };
+
+    struct snail_number {
+        static constexpr size_t capacity = 32;
+        std::array<leaf, capacity> leaves;
+        size_t size = 0;
+
+        leaf* begin() { return leaves.data(); }
+        leaf* end() { return leaves.data() + size; }
+        [[nodiscard]] const leaf* begin() const { return leaves.data(); }
+        [[nodiscard]] const leaf* end() const { return leaves.data() + size; }
+
+        void insert(size_t index, leaf l) {
+            assert(size < capacity);
+            std::copy_backward(begin() + index, end(), end() + 1);
+            leaves[index] = l;
+            ++size;
         }
-        return to_return;
-    }
+
+        void erase(size_t index) {
+            std::copy(begin() + index + 1, end(), begin() + index);
+            --size;
+        }
+    };
 
     snail_number read_snail_number(const std::string& s) {
-        std::stringstream ss(s);
-        return ox::binary_tree(read_snail_number(ss));
+        snail_number to_return;
+        int depth = 0;
+        for (const char* c = s.c_str(); *c; ++c) {
+            if (*c == '[') {
+                ++depth;
+            } else if (*c == ']') {
+                --depth;
+            } else if ('0' <= *c && *c <= '9') {
+                int value = static_cast<int>(strtol(c, const_cast<char**>(&c), 10));
+                to_return.insert(to_return.size, {value, depth});
+                --c;
+            }
+        }
+        return to_return;
     }
 
     snail_number add(const snail_number& a, const snail_number& b) {
-        snail_number_node to_return;
-        to_return.emplace_left(a.head);
-        to_return.emplace_right(b.head);
-        return ox::binary_tree(std::move(to_return));
+        snail_number to_return;
+        for (const leaf& l : a) {
+            to_return.leaves[to_return.size++] = {l.value, l.depth + 1};
+        }
+        for (const leaf& l : b) {
+            to_return.leaves[to_return.size++] = {l.value, l.depth + 1};
+        }
+        return to_return;
     }
 
-    int magnitude(const snail_number_node& node) {
-        if(node.value) {
-            return *node.value;
+    // Folds neighbouring values of equal depth back into their pair until only the root is left
+    template <typename T, typename Combine>
+    T fold_pairs(const snail_number& number, auto to_value, Combine combine) {
+        std::vector<std::pair<T, int>> stack;
+        for (const leaf& l : number) {
+            stack.emplace_back(to_value(l.value), l.depth);
+            while (stack.size() >= 2 && stack.back().second == stack[stack.size() - 2].second) {
+                auto [right, depth] = std::move(stack.back());
+                stack.pop_back();
+                stack.back() = {combine(std::move(stack.back().first), std::move(right)), depth - 1};
+            }
         }
-        return 3 * magnitude(node.get_left_child()) + 2 * magnitude(node.get_right_child());
+        return stack.empty() ? T{} : std::move(stack.back().first);
     }
 
-    void print_number(const snail_number_node& node) {
-        if (node.value) {
-            myprintf("%d", *node.value);
-        } else {
-            myprintf("[");
-            print_number(node.get_left_child());
-            myprintf(",");
-            print_number(node.get_right_child());
-            myprintf("]");
-        }
+    int magnitude(const snail_number& number) {
+        return fold_pairs<int>(number, std::identity(), [](int left, int right) { return 3 * left + 2 * right; });
     }
 
-    void explode(snail_number& source, snail_number::iterator d) {
-        auto& current = *d;
-        auto next = std::find_if(
-               std::next(snail_number::iterator(current.get_right_child())),
-               source.end(), [](const auto& x) { return x.value.has_value(); });
-        auto prev = std::find_if(
-               snail_number::reverse_iterator(snail_number::iterator(current.get_left_child())),
-               source.rend(), [](const auto& x) { return x.value.has_value(); });
-        if (prev != source.rend())
-            *prev->value += *current.get_left_child().value;
-        if (next != source.end())
-            *next->value += *current.get_right_child().value;
-        current.value = 0;
-        current.children.first.reset();
-        current.children.second.reset();
+    void print_number(const snail_number& number) {
+        auto text = fold_pairs<std::string>(
+                number,
+                [](int value) { return std::to_string(value); },
+                [](std::string left, std::string right) { return "[" + left + "," + right + "]"; });
+        myprintf("%s", text.c_str());
     }
+
+    // A pair nested in four others always has two regular numbers, which sit next to each other
     bool explode(snail_number& b) {
-        auto issue_finder = b | stdv::filter([](const auto& x) {
-            return !x.value && x.get_depth() >= 4;
-        });
-        auto current_iter = issue_finder.begin().base();
-        if (current_iter != b.end()) {
-            explode(b, current_iter);
-            return true;
-        }
-        return false;
+        auto d = stdr::find_if(b, [](const leaf& l) { return l.depth > 4; });
+        if (d == b.end())
+            return false;
+        auto i = static_cast<size_t>(d - b.begin());
+        if (i > 0)
+            b.leaves[i - 1].value += b.leaves[i].value;
+        if (i + 2 < b.size)
+            b.leaves[i + 2].value += b.leaves[i + 1].value;
+        b.leaves[i] = {0, b.leaves[i].depth - 1};
+        b.erase(i + 1);
+        return true;
     }
 
-    void split(snail_number::iterator d) {
-        auto& current = *d;
-        int old_value = *current.value;
-        current.emplace_left(old_value/2);
-        current.emplace_right(old_value/2 + old_value%2);
-        current.value.reset();
-    }
     bool split(snail_number& b) {
-        auto issue_finder2 = b | stdv::filter([](const auto& x) {
-            return x.value && *x.value >= 10;
-        });
-        auto current_iter = issue_finder2.begin().base();
-        if (current_iter != b.end()) {
-            split(current_iter);
-            return true;
-        }
-        return false;
+        auto d = stdr::find_if(b, [](const leaf& l) { return l.value >= 10; });
+        if (d == b.end())
+            return false;
+        auto i = static_cast<size_t>(d - b.begin());
+        auto [old_value, depth] = b.leaves[i];
+        b.leaves[i] = {old_value / 2, depth + 1};
+        b.insert(i + 1, {old_value / 2 + old_value % 2, depth + 1});
+        return true;
     }
 
     bool fix(snail_number& b) {
@@ -124,46 +133,58 @@ namespace aoc2021::day18 {
             auto z = read_snail_number(line);
 
             if (verbose_level >= 1) {
-                myprintf("  "); print_number(y.head);
-                myprintf("\n+ "); print_number(z.head);
+                myprintf("  "); print_number(y);
+                myprintf("\n+ "); print_number(z);
             }
             y = add(y, z);
             if (verbose_level >= 2) {
-                myprintf("\n= "); print_number(y.head);
+                myprintf("\n= "); print_number(y);
             }
 
             while(fix(y)) {
                 if(verbose_level >= 3) {
                     myprintf("\n= ");
-                    print_number(y.head);
+                    print_number(y);
                 }
             }
             if (verbose_level >= 1) {
                 myprintf("\n= ");
-                print_number(y.head);
+                print_number(y);
                 myprintf("\n\n");
             }
         }
-        int result = magnitude(y.head);
+        int result = magnitude(y);
         myprintf("final magnitude is equal to %d\n", result);
         return result;
     }
 
     answertype puzzle2(puzzle_options filename) {
         auto input = get_stream<ox::line>(filename);
-        int max = 0;
         std::vector<snail_number> numbers;
         stdr::transform(input, std::back_inserter(numbers), [](ox::line l) { return read_snail_number(l); });
-        for(const auto& left : numbers) {
-            for (const auto& right : numbers) {
-                if (&left == &right)
-                    continue;
-                auto y = add(left, right);
-                while(fix(y));
-                max = std::max(max, magnitude(y.head));
-            }
+
+        std::atomic<size_t> next = 0;
+        std::atomic<int> max = 0;
+        std::vector<std::thread> workers;
+        for (unsigned w = 0; w < std::max(1u, std::thread::hardware_concurrency()); ++w) {
+            workers.emplace_back([&] {
+                int local_max = 0;
+                for (size_t i; (i = next++) < numbers.size();) {
+                    for (size_t j = 0; j < numbers.size(); ++j) {
+                        if (i == j)
+                            continue;
+                        auto y = add(numbers[i], numbers[j]);
+                        while(fix(y));
+                        local_max = std::max(local_max, magnitude(y));
+                    }
+                }
+                for (int current = max; current < local_max && !max.compare_exchange_weak(current, local_max);) {}
+            });
+        }
+        for (auto& worker : workers) {
+            worker.join();
         }
-        myprintf("largest magnitude is equal to %d\n", max);
-        return max;
+        myprintf("largest magnitude is equal to %d\n", max.load());
+        return max.load();
     }
-} // namespace aoc2021::day18
\ No newline at end of file
+} // namespace aoc2021::day18
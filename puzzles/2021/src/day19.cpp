@@ -1,47 +1,104 @@
 #include "../../../common.h"
-#include "ox/matrix.h"
 #include <cassert>
-#include <queue>
-#include "ox/algorithms.h"
+#include <atomic>
+#include <thread>
+#include <unordered_map>
 
 #define DAY 19
 
 namespace aoc2021::day19 {
-    using transformation = ox::matrix<int>;
-    using beacon = ox::matrix<int>;
+    using beacon = std::array<int, 3>;
     using scanner = std::vector<beacon>;
+    using rotation = std::array<beacon, 3>;
 
-    static transformation rotate_z(3, {0, -1, 0, 1, 0, 0, 0, 0, 1});
-    static transformation rotate_y(3, {0, 0, -1, 0, 1, 0, 1, 0, 0});
-    static transformation rotate_x(3, {1, 0, 0, 0, 0, -1, 0, 1, 0});
-    static transformation identity(3, {1, 0, 0, 0, 1, 0, 0, 0, 1});
-
-    std::array<transformation, 24> rotation_combinations() {
-        std::array<transformation, 4 * 4 * 4> temp{};
-        std::array<transformation, 24> to_return{};
-        auto rotation_x = identity;
-        auto rotation_y = identity;
-        auto rotation_z = identity;
-        for (int i = 0; i < 4; i++, rotation_x = rotation_x * rotate_x) {
-            for (int j = 0; j < 4; j++, rotation_y = rotation_y * rotate_y) {
-                for (int k = 0; k < 4; k++, rotation_z = rotation_z * rotate_z) {
-                    temp.at(i * 16 + j * 4 + k) = (rotation_x * rotation_y * rotation_z);
+    constexpr size_t min_overlap = 12;
+    constexpr size_t min_shared_distances = min_overlap * (min_overlap - 1) / 2;
+    constexpr rotation identity{{{1, 0, 0}, {0, 1, 0}, {0, 0, 1}}};
+
+    constexpr int dot(const beacon& a, const beacon& b) { return a[0] * b[0] + a[1] * b[1] + a[2] * b[2]; }
+    constexpr beacon operator+(const beacon& a, const beacon& b) { return {a[0] + b[0], a[1] + b[1], a[2] + b[2]}; }
+    constexpr beacon operator-(const beacon& a, const beacon& b) { return {a[0] - b[0], a[1] - b[1], a[2] - b[2]}; }
+    constexpr beacon operator*(const rotation& r, const beacon& b) { return {dot(r[0], b), dot(r[1], b), dot(r[2], b)}; }
+
+    constexpr rotation transpose(const rotation& r) {
+        return {{{r[0][0], r[1][0], r[2][0]}, {r[0][1], r[1][1], r[2][1]}, {r[0][2], r[1][2], r[2][2]}}};
+    }
+
+    constexpr rotation operator*(const rotation& a, const rotation& b) {
+        rotation bt = transpose(b);
+        return {{{dot(a[0], bt[0]), dot(a[0], bt[1]), dot(a[0], bt[2])},
+                 {dot(a[1], bt[0]), dot(a[1], bt[1]), dot(a[1], bt[2])},
+                 {dot(a[2], bt[0]), dot(a[2], bt[1]), dot(a[2], bt[2])}}};
+    }
+
+    constexpr int determinant(const rotation& r) {
+        return r[0][0] * (r[1][1] * r[2][2] - r[1][2] * r[2][1]) - r[0][1] * (r[1][0] * r[2][2] - r[1][2] * r[2][0])
+             + r[0][2] * (r[1][0] * r[2][1] - r[1][1] * r[2][0]);
+    }
+
+    // Every signed permutation matrix that keeps handedness
+    constexpr std::array<rotation, 24> rotation_combinations() {
+        std::array<rotation, 24> to_return{};
+        std::array<int, 3> axes{0, 1, 2};
+        size_t count = 0;
+        do {
+            for (int signs = 0; signs < 8; ++signs) {
+                rotation r{};
+                for (int i = 0; i < 3; ++i) {
+                    r[i][axes[i]] = signs & (1 << i) ? -1 : 1;
                 }
+                if (determinant(r) == 1)
+                    to_return[count++] = r;
             }
-        }
-
-        std::sort(temp.begin(), temp.end(), std::greater<>());
-        auto x = std::unique(temp.begin(), temp.end());
-        std::copy(temp.begin(), x, to_return.begin());
+        } while (std::next_permutation(axes.begin(), axes.end()));
         return to_return;
     }
 
-    static auto& get_rotation_combinations() {
-        static std::array<transformation, 24> all_3d_rotations = rotation_combinations();
-        return all_3d_rotations;
+    constexpr std::array<rotation, 24> all_3d_rotations = rotation_combinations();
+
+    // Maps coordinates relative to one scanner into the frame of another
+    struct transformation {
+        rotation r = identity;
+        beacon t{};
+
+        beacon operator()(const beacon& b) const { return r * b + t; }
+        transformation operator*(const transformation& inner) const { return {r * inner.r, r * inner.t + t}; }
+        [[nodiscard]] transformation inverse() const {
+            rotation rt = transpose(r);
+            return {rt, beacon{} - rt * t};
+        }
+    };
+
+    // The sorted absolute axis deltas between two beacons do not change under any of the 24 rotations,
+    // so two scanners seeing the same 12 beacons share at least 66 of these keys.
+    long distance_key(beacon delta) {
+        for (int& c : delta) {
+            c = std::abs(c);
+        }
+        stdr::sort(delta);
+        return (static_cast<long>(delta[0]) << 42) | (static_cast<long>(delta[1]) << 21) | delta[2];
     }
 
-    static std::vector<std::pair<scanner, ox::matrix<int>>> final_offsets;
+    struct fingerprint {
+        std::unordered_map<long, std::vector<std::pair<int, int>>> pairs;
+
+        explicit fingerprint(const scanner& s) {
+            for (int i = 0; i < static_cast<int>(s.size()); ++i) {
+                for (int j = i + 1; j < static_cast<int>(s.size()); ++j) {
+                    pairs[distance_key(s[j] - s[i])].emplace_back(i, j);
+                }
+            }
+        }
+
+        [[nodiscard]] size_t shared_with(const fingerprint& other) const {
+            size_t count = 0;
+            for (const auto& [key, list] : pairs) {
+                if (auto found = other.pairs.find(key); found != other.pairs.end())
+                    count += std::min(list.size(), found->second.size());
+            }
+            return count;
+        }
+    };
 
     beacon parse_beacon(std::istream& in) {
         int x, y, z;
@@ -50,14 +107,14 @@ namespace aoc2021::day19 {
         in >> x >> l >> y >> m >> z;
         assert(l == ',' && m == ',');
 
-        return beacon(1, {x, y, z});
+        return {x, y, z};
     }
 
     scanner parse_scanner(std::istream& in) {
         scanner to_return;
         assert(in.peek() == '-');
         in.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-        while (in && in.peek() != '\n') {
+        while (in && in.peek() != '\n' && in.peek() != EOF) {
             to_return.push_back(parse_beacon(in));
             in.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
         }
@@ -67,46 +124,44 @@ namespace aoc2021::day19 {
 
     std::vector<scanner> parse_input(std::istream& in) {
         std::vector<scanner> to_return;
-        while (in) {
+        while (in >> std::ws && in.peek() == '-') {
             to_return.push_back(parse_scanner(in));
         }
         return to_return;
     }
 
-    std::optional<ox::matrix<int>> change_scanner_b_relative_to_a(const scanner& a, scanner& b) {
-        static scanner a_cpy;
-        static scanner b_rotated;
-        static scanner b_cpy;
-        static scanner merged;
-
-        a_cpy.resize(a.size());
-        b_cpy.resize(b.size());
-        b_rotated.resize(b.size());
-
-        for (const auto& rotation : get_rotation_combinations()) {
-            std::copy(b.begin(), b.end(), b_rotated.begin());
-            for (size_t i = 0; i < b.size(); i++) {
-                ox::matrix<int>::in_place_multiplication(b_rotated[i], rotation, b[i]);
-            }
+    size_t count_overlap(const scanner& a, const scanner& b, const transformation& b_to_a) {
+        size_t overlap = 0;
+        for (size_t i = 0; i < b.size() && overlap + (b.size() - i) >= min_overlap; ++i) {
+            overlap += std::binary_search(a.begin(), a.end(), b_to_a(b[i]));
+        }
+        return overlap;
+    }
 
-            for (const auto& beacon_from_b : b_rotated) {
-                std::copy(b_rotated.begin(), b_rotated.end(), b_cpy.begin());
-                for (auto& b_cpy_elem : b_cpy) {
-                    b_cpy_elem -= beacon_from_b;
-                }
-                stdr::sort(b_cpy);
+    // Anchors are beacon pairs with the same fingerprint key in both scanners; the rotation is then the one mapping
+    // the anchor's delta in b onto its delta in a. With unique_only, only keys that occur once in each scanner are
+    // tried, which settles nearly every pair of scanners on the first anchor.
+    std::optional<transformation> change_scanner_b_relative_to_a(const scanner& a, const fingerprint& fa,
+                                                                 const scanner& b, const fingerprint& fb,
+                                                                 bool unique_only) {
+        for (const auto& [key, a_pairs] : fa.pairs) {
+            auto found = fb.pairs.find(key);
+            if (found == fb.pairs.end() || (unique_only && (a_pairs.size() != 1 || found->second.size() != 1)))
+                continue;
+            for (auto [a1, a2] : a_pairs) {
+                for (auto [b1, b2] : found->second) {
+                    beacon da = a[a2] - a[a1];
+                    beacon db = b[b2] - b[b1];
 
-                for (const auto& beacon_from_one : a) {
-                    std::copy(a.begin(), a.end(), a_cpy.begin());
-                    for (auto& a_cpy_elem : a_cpy) {
-                        a_cpy_elem -= beacon_from_one;
-                    }
-                    stdr::sort(a_cpy);
-                    size_t overlap = 0;
-                    std::set_intersection(a_cpy.begin(), a_cpy.end(), b_cpy.begin(), b_cpy.end(), ox::predicateCounter<ox::matrix<int>>(overlap));
-                    if (overlap >= 12) {
-                        std::transform(b_cpy.begin(), b_cpy.end(), b.begin(), [&beacon_from_one](auto x) { return x += beacon_from_one; });
-                        return beacon_from_one - beacon_from_b;
+                    for (const rotation& r : all_3d_rotations) {
+                        beacon rotated = r * db;
+                        std::optional<transformation> candidate;
+                        if (rotated == da)
+                            candidate = transformation{r, a[a1] - r * b[b1]};
+                        else if (rotated == beacon{} - da)
+                            candidate = transformation{r, a[a2] - r * b[b1]};
+                        if (candidate && count_overlap(a, b, *candidate) >= min_overlap)
+                            return candidate;
                     }
                 }
             }
@@ -114,59 +169,116 @@ namespace aoc2021::day19 {
         return std::nullopt;
     }
 
-    answertype puzzle1(puzzle_options filename) {
-        auto stream(get_stream<int>(filename));
-        auto input = parse_input(stream);
-        std::queue<std::pair<scanner, ox::matrix<int>>> todo;
-
-        todo.push(std::make_pair(std::move(input.front()), ox::matrix<int>(1, {0, 0, 0})));
-        input.erase(input.begin());
-
-        while (!todo.empty()) {
-            std::vector<scanner> new_input;
-            auto s = todo.front();
-            todo.pop();
-            for (auto& it : input) {
-                auto overlap = change_scanner_b_relative_to_a(s.first, it);
-                if (overlap) {
-                    todo.push(std::make_pair(std::move(it), *overlap));
-                } else {
-                    new_input.push_back(std::move(it));
+    struct scanner_map {
+        std::vector<beacon> beacons;
+        std::vector<beacon> positions;
+        size_t unaligned = 0;
+    };
+
+    scanner_map align_scanners(std::vector<scanner> scanners) {
+        for (auto& s : scanners) {
+            stdr::sort(s);
+        }
+        std::vector<fingerprint> fingerprints;
+        fingerprints.reserve(scanners.size());
+        for (const auto& s : scanners) {
+            fingerprints.emplace_back(s);
+        }
+
+        std::vector<std::pair<size_t, size_t>> candidates;
+        for (size_t i = 0; i < scanners.size(); ++i) {
+            for (size_t j = i + 1; j < scanners.size(); ++j) {
+                if (fingerprints[i].shared_with(fingerprints[j]) >= min_shared_distances)
+                    candidates.emplace_back(i, j);
+            }
+        }
+
+        std::vector<std::optional<transformation>> found(candidates.size());
+        std::atomic<size_t> next = 0;
+        std::vector<std::thread> workers;
+        for (unsigned w = 0; w < std::max(1u, std::thread::hardware_concurrency()); ++w) {
+            workers.emplace_back([&] {
+                for (size_t k; (k = next++) < candidates.size();) {
+                    auto [i, j] = candidates[k];
+                    const auto &a = scanners[i], &b = scanners[j];
+                    found[k] = change_scanner_b_relative_to_a(a, fingerprints[i], b, fingerprints[j], true);
+                    if (!found[k])
+                        found[k] = change_scanner_b_relative_to_a(a, fingerprints[i], b, fingerprints[j], false);
                 }
+            });
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+
+        std::vector<std::vector<std::pair<size_t, transformation>>> edges(scanners.size());
+        for (size_t k = 0; k < candidates.size(); ++k) {
+            if (!found[k])
+                continue;
+            auto [i, j] = candidates[k];
+            edges[i].emplace_back(j, *found[k]);
+            edges[j].emplace_back(i, found[k]->inverse());
+        }
+
+        std::vector<std::optional<transformation>> to_origin(scanners.size());
+        std::vector<size_t> queue{0};
+        to_origin[0] = transformation{};
+        for (size_t q = 0; q < queue.size(); ++q) {
+            size_t i = queue[q];
+            for (const auto& [j, j_to_i] : edges[i]) {
+                if (to_origin[j])
+                    continue;
+                to_origin[j] = *to_origin[i] * j_to_i;
+                queue.push_back(j);
             }
-            input = std::move(new_input);
-            final_offsets.push_back(std::move(s));
         }
 
-        for (auto& scanner : final_offsets) {
-            stdr::sort(scanner.first);
+        scanner_map to_return;
+        for (size_t i = 0; i < scanners.size(); ++i) {
+            if (!to_origin[i]) {
+                ++to_return.unaligned;
+                continue;
+            }
+            to_return.positions.push_back(to_origin[i]->t);
+            stdr::transform(scanners[i], std::back_inserter(to_return.beacons), *to_origin[i]);
         }
+        stdr::sort(to_return.beacons);
+        auto duplicates = stdr::unique(to_return.beacons);
+        to_return.beacons.erase(duplicates.begin(), duplicates.end());
+        return to_return;
+    }
 
-        auto full_list = std::accumulate(final_offsets.begin(), final_offsets.end(), scanner{}, [](const auto& sum, const auto& scanner) {
-            std::vector<beacon> b;
-            b.reserve(sum.size() + scanner.first.size());
-            stdr::merge(sum, scanner.first, std::back_inserter(b));
-            return b;
-        });
+    scanner_map get_scanner_map(puzzle_options filename) {
+        auto stream(get_stream<int>(filename));
+        return align_scanners(parse_input(stream));
+    }
 
-        myprintf("Full list size: %zu\n", full_list.size());
-        auto unique_end = std::unique(full_list.begin(), full_list.end());
-        myprintf("unique list size: %zu\n", unique_end - full_list.begin());
-        return unique_end - full_list.begin();
+    answertype puzzle1(puzzle_options filename) {
+        auto map = get_scanner_map(filename);
+        if (map.unaligned) {
+            myprintf("%zu scanners could not be aligned with scanner 0\n", map.unaligned);
+            return {};
+        }
+        myprintf("unique list size: %zu\n", map.beacons.size());
+        return map.beacons.size();
     }
 
-    answertype puzzle2([[maybe_unused]] puzzle_options filename) {
+    answertype puzzle2(puzzle_options filename) {
+        auto map = get_scanner_map(filename);
+        if (map.unaligned) {
+            myprintf("%zu scanners could not be aligned with scanner 0\n", map.unaligned);
+            return {};
+        }
         int max = 0;
 
-        for (auto x = final_offsets.begin(); x != final_offsets.end(); ++x) {
-            for (auto y = x; y != final_offsets.end(); ++y) {
-                ox::matrix<int> a = x->second;
-                ox::matrix<int> b = y->second;
-                max = std::max(max, std::abs(a[0] - b[0]) + std::abs(a[1] - b[1]) + std::abs(a[2] - b[2]));
+        for (auto x = map.positions.begin(); x != map.positions.end(); ++x) {
+            for (auto y = x; y != map.positions.end(); ++y) {
+                beacon d = *x - *y;
+                max = std::max(max, std::abs(d[0]) + std::abs(d[1]) + std::abs(d[2]));
             }
         }
 
         myprintf("Largest distance is %d\n", max);
         return max;
     }
-} // namespace aoc2021::day19
\ No newline at end of file
+} // namespace aoc2021::day19
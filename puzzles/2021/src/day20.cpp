@@ -1,90 +1,164 @@
 #include "../../../common.h"
-#include "ox/grid.h"
 #include <algorithm>
+#include <bit>
 #include <numeric>
 
 #define DAY 20
 
 namespace aoc2021::day20 {
-    constexpr std::array<std::pair<int, int>, 9> cardinal_directions = {{
-           {-1, -1}, {0, -1}, {1, -1},
-           {-1, 0}, {0, 0}, {1, 0},
-           {-1, 1}, {0, 1}, {1, 1}
-    }};
+    using word = uint64_t;
+    constexpr size_t word_bits = 64;
 
-    std::vector<bool> parse_decoder(std::istream& in) {
+    // The enhancement rule as a multiplexer tree: the first level chooses between entries i and i + 256 on the
+    // top-left neighbour, and every further level halves the table on the next neighbour in reading order.
+    // Evaluated on words holding one neighbour plane each, it decodes 64 pixels at once.
+    struct decoder {
+        std::array<word, 256> base{};
+        std::array<word, 256> flip{};
+        bool on_dark = false;
+        bool on_lit = false;
+
+        [[nodiscard]] word apply(const std::array<word, 9>& planes) const {
+            std::array<word, 256> v;
+            for (size_t k = 0; k < 256; ++k)
+                v[k] = base[k] ^ (flip[k] & planes[0]);
+            size_t plane = 1;
+            for (size_t half = 128; half > 0; half >>= 1, ++plane) {
+                for (size_t k = 0; k < half; ++k)
+                    v[k] ^= (v[k] ^ v[k + half]) & planes[plane];
+            }
+            return v[0];
+        }
+    };
+
+    decoder parse_decoder(std::istream& in) {
         std::string s;
-        std::vector<bool> to_return;
-        to_return.reserve(513);
+        std::vector<bool> rule;
+        rule.reserve(512);
         while (std::getline(in, s) && !s.empty()) {
-            std::transform(s.begin(), s.end(), std::back_inserter(to_return), [](char c) { return c == '#'; } );
+            std::transform(s.begin(), s.end(), std::back_inserter(rule), [](char c) { return c == '#'; });
+        }
+
+        decoder to_return;
+        for (size_t k = 0; k < 256; ++k) {
+            to_return.base[k] = rule[k] ? ~word(0) : 0;
+            to_return.flip[k] = rule[k] != rule[k + 256] ? ~word(0) : 0;
         }
+        to_return.on_dark = rule.front();
+        to_return.on_lit = rule.back();
         return to_return;
     }
 
-    std::pair<ox::grid<bool>, bool> next_image(const ox::grid<bool>& image, const std::vector<bool>& decoder, bool empty_space) {
-        bool new_empty_space = empty_space ? decoder.back() : decoder.front();
-        ox::grid<bool> new_image(image.get_width() + 2, (image.get_width() + 2) * (image.get_height() + 2));
+    // A fixed canvas large enough for every planned iteration, with the input placed in the middle. Each row is
+    // framed by one word on each side, and the canvas by one row above and below, all holding the background;
+    // pixels that the growing image has not reached yet simply decode to the next background.
+    class image {
+        std::vector<word> cells;
+        std::vector<word> scratch;
+        size_t words = 0;
+        size_t stride = 0;
+        size_t height = 0;
+        bool background = false;
 
-        for(std::size_t j : stdv::iota(std::size_t(0), new_image.get_width())) {
-            for (std::size_t i : stdv::iota(std::size_t(0), new_image.get_height())) {
-                auto neighbours = cardinal_directions | stdv::transform([i, j, empty_space,&image](auto offset) {
-                    std::optional<bool> get_opt = image.get(i + offset.first - 1, j + offset.second - 1);
-                    return get_opt.value_or(empty_space);
-                });
+        [[nodiscard]] static word left(const word* row, size_t w) { return (row[w] << 1) | (row[w - 1] >> 63); }
+        [[nodiscard]] static word right(const word* row, size_t w) { return (row[w] >> 1) | (row[w + 1] << 63); }
 
-                auto index = std::accumulate(neighbours.begin(), neighbours.end(), 0, [](int sum, bool next) {
-                    return (sum << 1) + next;
-                });
+        void fill_frame(std::vector<word>& canvas, bool lit) const {
+            word fill = lit ? ~word(0) : 0;
+            std::fill_n(canvas.begin(), stride, fill);
+            std::fill_n(canvas.end() - static_cast<long>(stride), stride, fill);
+            for (size_t y = 1; y <= height; ++y) {
+                canvas[y * stride] = fill;
+                canvas[y * stride + words + 1] = fill;
+            }
+        }
+
+    public:
+        image(std::istream& in, size_t max_iterations) {
+            std::vector<std::string> lines;
+            std::string s;
+            while (std::getline(in, s) && !s.empty())
+                lines.push_back(s);
 
-                new_image.at(i, j) = decoder[index];
+            size_t margin = max_iterations + 1;
+            words = (lines.front().size() + 2 * margin + word_bits - 1) / word_bits;
+            stride = words + 2;
+            height = lines.size() + 2 * margin;
+            cells.assign(stride * (height + 2), 0);
+            scratch.assign(cells.size(), 0);
+
+            for (size_t j = 0; j < lines.size(); ++j) {
+                for (size_t i = 0; i < lines[j].size(); ++i) {
+                    if (lines[j][i] != '#')
+                        continue;
+                    size_t x = i + margin;
+                    cells[(j + margin + 1) * stride + 1 + x / word_bits] |= word(1) << (x % word_bits);
+                }
             }
         }
 
-        return {new_image, new_empty_space};
-    }
+        void enhance(const decoder& rule) {
+            bool next_background = background ? rule.on_lit : rule.on_dark;
+            for (size_t y = 1; y <= height; ++y) {
+                const word* up = &cells[(y - 1) * stride];
+                const word* mid = up + stride;
+                const word* down = mid + stride;
+                word* out = &scratch[y * stride];
+                for (size_t w = 1; w <= words; ++w) {
+                    out[w] = rule.apply({
+                            left(up, w), up[w], right(up, w),
+                            left(mid, w), mid[w], right(mid, w),
+                            left(down, w), down[w], right(down, w),
+                    });
+                }
+            }
+            fill_frame(scratch, next_background);
+            std::swap(cells, scratch);
+            background = next_background;
+        }
 
-    void print_image(const ox::grid<bool>& image) {
-        image.leveled_foreach(
-               [](bool i) { myprintf("%c", i ? '#' : '.'); },
-               []() { myprintf("\n"); }
-        );
-    }
+        [[nodiscard]] long count() const {
+            long total = 0;
+            for (size_t y = 1; y <= height; ++y) {
+                for (size_t w = 1; w <= words; ++w)
+                    total += std::popcount(cells[y * stride + w]);
+            }
+            return total;
+        }
 
-    static ox::grid<bool> source;
-    static ox::grid<bool> image;
-    static bool empty = false;
+        void print() const {
+            for (size_t y = 1; y <= height; ++y) {
+                for (size_t x = 0; x < words * word_bits; ++x)
+                    myprintf("%c", (cells[y * stride + 1 + x / word_bits] >> (x % word_bits)) & 1 ? '#' : '.');
+                myprintf("\n");
+            }
+        }
+    };
+
+    static std::optional<image> enhanced;
+    static decoder rule;
     static int puzzle_1_iteration_count = 2;
     static int puzzle_2_iteration_count = 50;
-    static std::vector<bool> decoder;
 
     answertype puzzle1(puzzle_options filename) {
-        int iteration_count = 2;
         auto in_stream = get_stream<ox::line>(filename);
-        decoder = parse_decoder(in_stream);
-        source = ox::grid<bool>(in_stream, [](char a) mutable { return a == '#'; });
-
-        image = source;
-        for (int i = 0; i < iteration_count; i++) {
-            auto [new_image, new_empty] = next_image(image, decoder, empty);
-            empty = new_empty;
-            image = std::move(new_image);
-        }
+        rule = parse_decoder(in_stream);
+        enhanced.emplace(in_stream, puzzle_2_iteration_count);
 
-        auto count = std::count(image.get_raw().begin(), image.get_raw().end(), true);
+        for (int i = 0; i < puzzle_1_iteration_count; i++)
+            enhanced->enhance(rule);
+
+        auto count = enhanced->count();
         myprintf("Total number of # are %ld\n\n", count);
         return count;
     }
 
     answertype puzzle2([[maybe_unused]] puzzle_options filename) {
-        for (int i = puzzle_1_iteration_count; i < puzzle_2_iteration_count; i++) {
-            auto [new_image, new_empty] = next_image(image, decoder, empty);
-            empty = new_empty;
-            image = std::move(new_image);
-        }
+        for (int i = puzzle_1_iteration_count; i < puzzle_2_iteration_count; i++)
+            enhanced->enhance(rule);
 
-        print_image(image);
-        auto count = std::count(image.get_raw().begin(), image.get_raw().end(), true);
+        enhanced->print();
+        auto count = enhanced->count();
         myprintf("Total number of # are %ld\n", count);
         return count;
     }
@@ -1,9 +1,7 @@
 #include "../../../common.h"
-#include "ox/ranges.h"
 #include <ranges>
 #include "ox/debug.h"
 #include <limits>
-#include <thread>
 
 #define DAY 21
 
@@ -13,8 +11,6 @@ namespace aoc2021::day21 {
         constexpr static int sides_of_die = 100;
         constexpr static int rolls_per_turn = 3;
         constexpr static int spaces_on_board = 10;
-        decltype(stdv::iota(1, sides_of_die+1) | ox::ranges::views::repeat()) deterministic_dice = stdv::iota(1, 101) | ox::ranges::views::repeat();
-        decltype(deterministic_dice.begin()) dice_roller = deterministic_dice.begin();
         using player = std::pair<int, int>;
         std::array<player, 2> player_scores;
         int total_number_of_dice_roles = 0;
@@ -28,18 +24,14 @@ namespace aoc2021::day21 {
             }
         }
 
-        int get_next_roll() {
-            total_number_of_dice_roles++;
-            return *dice_roller++;
-        }
-
+        // The deterministic die shows (n % sides) + 1 on its n-th roll
         bool take_turn(int player) {
             auto& [player_placement, player_score] = player_scores.at(player);
 
-            for ([[maybe_unused]] int i : stdv::iota(0, rolls_per_turn)) {
-                int move = get_next_roll();
-                player_placement += move;
+            for (int i = 0; i < rolls_per_turn; ++i) {
+                player_placement += (total_number_of_dice_roles + i) % sides_of_die + 1;
             }
+            total_number_of_dice_roles += rolls_per_turn;
             player_placement %= spaces_on_board;
             player_score += player_placement + 1;
             return player_score >= winning_score;
@@ -83,14 +75,55 @@ namespace aoc2021::day21 {
     template <int Side, int Rolls>
     constexpr static std::array<std::pair<int, int>, Side * Rolls> die_frequency = get_die_frequency<Side, Rolls>();
 
+    // Number of universes won by the player about to move and by the other player, for every
+    // (position to move, other position, score to move, other score). A state only depends on states where the
+    // player who just moved has a higher score, so the flat table is filled by decreasing total score.
+    template <int WinningScore, int BoardSize, int DieSides, int Rolls>
+    struct dirac_game {
+        using wins = std::array<long, 2>;
+
+        static constexpr size_t index(int position, int other_position, int score, int other_score) {
+            return ((static_cast<size_t>(position) * BoardSize + other_position) * WinningScore + score) * WinningScore
+                 + other_score;
+        }
+
+        static std::vector<wins> build_table() {
+            std::vector<wins> table(BoardSize * BoardSize * WinningScore * WinningScore);
+            for (int total = 2 * (WinningScore - 1); total >= 0; --total) {
+                for (int score = std::min(total, WinningScore - 1); score >= 0 && total - score < WinningScore; --score) {
+                    int other_score = total - score;
+                    for (int position = 0; position < BoardSize; ++position) {
+                        for (int other_position = 0; other_position < BoardSize; ++other_position) {
+                            wins& w = table[index(position, other_position, score, other_score)];
+                            for (auto [roll, frequency] : die_frequency<DieSides, Rolls>) {
+                                if (frequency == 0)
+                                    continue;
+                                int next_position = (position + roll) % BoardSize;
+                                int next_score = score + next_position + 1;
+                                if (next_score >= WinningScore) {
+                                    w[0] += frequency;
+                                    continue;
+                                }
+                                const wins& next = table[index(other_position, next_position, other_score, next_score)];
+                                w[0] += frequency * next[1];
+                                w[1] += frequency * next[0];
+                            }
+                        }
+                    }
+                }
+            }
+            return table;
+        }
+
+        static wins victories(int first_position, int second_position) {
+            static const std::vector<wins> table = build_table();
+            return table[index(first_position, second_position, 0, 0)];
+        }
+    };
+
     struct part2_simulation {
-        constexpr static int winning_score = 21;
-        constexpr static int sides_of_die = 3;
-        constexpr static int rolls_per_turn = 3;
-        constexpr static int spaces_on_board = 10;
-        using player = std::pair<int, int>;
+        using game = dirac_game<21, 10, 3, 3>;
         std::array<int, 2> starting_positions{};
-        std::array<std::atomic_long, 2> number_of_victories{};
 
         part2_simulation(stdr::range auto& f) {
             int starting = 0;
@@ -101,60 +134,14 @@ namespace aoc2021::day21 {
             }
         }
 
-        void _recursion(const std::array<player, 2>& players, int current_player, long identical_universes = 1) {
-            for (auto quantum : die_frequency<sides_of_die, rolls_per_turn>) {
-                if (quantum.second == 0)
-                    continue;
-                auto cpy = players;
-                auto& [position, score] = cpy[current_player];
-                position += quantum.first;
-                position %= spaces_on_board;
-                score += (position + 1);
-                if (score >= winning_score) {
-                    number_of_victories[current_player] += (identical_universes * quantum.second);
-                    continue;
-                }
-                _recursion(cpy, !current_player, identical_universes * quantum.second);
-           }
-        }
-
-        long simulate() {
-#ifdef _LIBCPP_VERSION
-            volatile std::atomic_bool stop = false;
-            std::thread a([this, &stop]() {
-#else
-            std::jthread a([this](const std::stop_token& stop_token) {
-#endif
-                using namespace std::literals::chrono_literals;
-#ifdef _LIBCPP_VERSION
-                while (!stop.load()) {
-#else
-                while(!stop_token.stop_requested()) {
-#endif
-                    myprintf("%ld | %ld\r", number_of_victories[0].load(), number_of_victories[1].load());
-                    fflush(stdout);
-                    std::this_thread::sleep_for(100ms);
-                }
-            });
-
-            _recursion({{{starting_positions[0], 0}, {starting_positions[1], 0}}}, 0);
-#ifdef _LIBCPP_VERSION
-            stop = true;
-#else
-            a.request_stop();
-#endif
-            myprintf("player 1 won %ld times\n", number_of_victories[0].load());
-            myprintf("player 2 won %ld times\n", number_of_victories[1].load());
-            return std::max(number_of_victories[0].load(), number_of_victories[1].load());
-#ifdef _LIBCPP_VERSION
-            a.join();
-#endif
+        [[nodiscard]] long simulate() const {
+            auto [first, second] = game::victories(starting_positions[0], starting_positions[1]);
+            myprintf("player 1 won %ld times\n", first);
+            myprintf("player 2 won %ld times\n", second);
+            return std::max(first, second);
         }
     };
 
-
-
-
     answertype puzzle1(puzzle_options filename) {
         auto input = get_stream<ox::line>(filename);
         part1_simulation s(input);
@@ -1,9 +1,10 @@
 #include "../../../common.h"
-#include <functional>
+#include <atomic>
+#include <chrono>
 #include <numeric>
-#include <cmath>
-#include <cassert>
-#include "ox/ranges.h"
+#include <random>
+#include <thread>
+#include <unordered_map>
 
 #define DAY 22
 
@@ -30,30 +31,16 @@ namespace aoc2021::day22 {
         }
     };
 
+    struct cube_hash {
+        size_t operator()(const cube& c) const {
+            return std::hash<std::string_view>()(std::string_view(reinterpret_cast<const char*>(&c), sizeof(c)));
+        }
+    };
+
     struct instruction : public cube {
         bool on;
     };
 
-    std::vector<cube> distribute_intersection(
-           const cube& base, std::random_access_iterator auto cube_begin, std::random_access_iterator auto cube_end) {
-        auto x = stdr::subrange(cube_begin, cube_end)
-               | stdv::transform([&](const cube& c) { return base * c; })
-               | stdv::filter([](const cube& c) { return c.valid(); });
-        return std::vector(x.begin(), x.end());
-    }
-
-    long union_area(std::random_access_iterator auto cube_begin, std::random_access_iterator auto cube_end) {
-        if (cube_begin == cube_end)
-            return 0l;
-        auto head_end = std::prev(cube_end);
-        auto& base = *head_end;
-        auto distributed = distribute_intersection(base, cube_begin, head_end);
-        long head_volume = union_area(cube_begin, std::prev(cube_end));
-        long tail_volume = base.area();
-        long tail_union = union_area(distributed.begin(), distributed.end());
-        return head_volume + tail_volume - tail_union;
-    }
-
     STREAM_IN(instruction, inst) {
         std::string s;
         std::getline(in, s);
@@ -66,39 +53,197 @@ namespace aoc2021::day22 {
         return in;
     }
 
-    static std::vector<instruction> instructions;
-
     template<long N>
     constexpr cube bounds{-1 * N, N, -1 * N, N, -1 * N, N};
 
-    long solve(bool within_bounds = false) {
-        long total_area = 0;
-        for (auto& cube_itr : instructions
-                      | ox::ranges::views::iterators
-                      | stdv::filter([](const auto& inst) { return inst->on; })) {
-            cube head = *cube_itr;
-            if (within_bounds)
-                head = head * bounds<50>;
-            if (!head.valid())
-                continue;
-            long temp_volume = head.area();
-            auto distributed = distribute_intersection(head, std::next(cube_itr), instructions.end());
-            long negative_volume = union_area(distributed.begin(), distributed.end());
-            long result_volume = temp_volume - negative_volume;
-            assert(result_volume >= 0);
-            total_area += result_volume;
+    enum class volume_mode { signed_cuboids, sweep };
+
+    // Every instruction adds the negated intersection with each cuboid seen so far, and itself if it is on.
+    // Identical cuboids are merged by their summed sign, so overlaps that cancel out stop spawning new ones.
+    long signed_volume(const std::vector<instruction>& instructions) {
+        std::unordered_map<cube, long, cube_hash> signed_cubes;
+        std::unordered_map<cube, long, cube_hash> update;
+        for (const instruction& inst : instructions) {
+            update.clear();
+            for (const auto& [c, sign] : signed_cubes) {
+                if (cube overlap = c * inst; overlap.valid())
+                    update[overlap] -= sign;
+            }
+            if (inst.on)
+                update[inst] += 1;
+            for (const auto& [c, sign] : update) {
+                if ((signed_cubes[c] += sign) == 0)
+                    signed_cubes.erase(c);
+            }
+        }
+        return std::accumulate(signed_cubes.begin(), signed_cubes.end(), 0l, [](long sum, const auto& signed_cube) {
+            return sum + signed_cube.first.area() * signed_cube.second;
+        });
+    }
+
+    // Area of one x slab, sweeping y over the start and end events of the instructions covering the slab. The z axis
+    // is compressed to the boundaries of those instructions, and every z cell keeps a max-heap of the instructions
+    // covering it at the current y, so the latest one decides the cell. Ended instructions leave the heaps lazily,
+    // and the lit length of the line is updated on every event instead of being rebuilt.
+    long plane_area(const std::vector<const instruction*>& active) {
+        std::vector<long> zs;
+        for (const instruction* inst : active) {
+            zs.push_back(inst->z1);
+            zs.push_back(inst->z2 + 1);
+        }
+        stdr::sort(zs);
+        zs.erase(std::unique(zs.begin(), zs.end()), zs.end());
+        auto cell_of = [&zs](long z) { return static_cast<size_t>(stdr::lower_bound(zs, z) - zs.begin()); };
+
+        std::vector<std::pair<long, long>> events;
+        for (size_t i = 0; i < active.size(); ++i) {
+            events.emplace_back(active[i]->y1, static_cast<long>(i) + 1);
+            events.emplace_back(active[i]->y2 + 1, -(static_cast<long>(i) + 1));
+        }
+        stdr::sort(events);
+
+        std::vector<std::vector<size_t>> covering(zs.size());
+        std::vector<char> ended(active.size(), false);
+        auto lit = [&](size_t cell) {
+            return !covering[cell].empty() && active[covering[cell].front()]->on ? zs[cell + 1] - zs[cell] : 0;
+        };
+
+        long length = 0;
+        long area = 0;
+        for (size_t e = 0; e < events.size();) {
+            long y = events[e].first;
+            for (; e < events.size() && events[e].first == y; ++e) {
+                long id = events[e].second;
+                auto i = static_cast<size_t>(std::abs(id) - 1);
+                ended[i] = id < 0;
+                for (size_t cell = cell_of(active[i]->z1), last = cell_of(active[i]->z2 + 1); cell < last; ++cell) {
+                    std::vector<size_t>& heap = covering[cell];
+                    if (id < 0 && heap.front() != i)
+                        continue;
+                    length -= lit(cell);
+                    if (id > 0) {
+                        heap.push_back(i);
+                        stdr::push_heap(heap);
+                    }
+                    while (!heap.empty() && ended[heap.front()]) {
+                        stdr::pop_heap(heap);
+                        heap.pop_back();
+                    }
+                    length += lit(cell);
+                }
+            }
+            if (e < events.size())
+                area += (events[e].first - y) * length;
+        }
+        return area;
+    }
+
+    // The x axis is compressed to the instruction boundaries and every slab between two of them
+    // is solved independently in 2D, spread over all hardware threads.
+    long sweep_volume(const std::vector<instruction>& instructions) {
+        std::vector<long> xs;
+        for (const instruction& inst : instructions) {
+            xs.push_back(inst.x1);
+            xs.push_back(inst.x2 + 1);
+        }
+        stdr::sort(xs);
+        xs.erase(std::unique(xs.begin(), xs.end()), xs.end());
+        if (xs.size() < 2)
+            return 0;
+
+        std::vector<long> slab_volume(xs.size() - 1);
+        std::atomic<size_t> next = 0;
+        std::vector<std::thread> workers;
+        for (unsigned w = 0; w < std::max(1u, std::thread::hardware_concurrency()); ++w) {
+            workers.emplace_back([&] {
+                std::vector<const instruction*> active;
+                for (size_t i; (i = next++) < slab_volume.size();) {
+                    active.clear();
+                    for (const instruction& inst : instructions) {
+                        if (inst.x1 <= xs[i] && inst.x2 + 1 >= xs[i + 1])
+                            active.push_back(&inst);
+                    }
+                    slab_volume[i] = (xs[i + 1] - xs[i]) * plane_area(active);
+                }
+            });
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        return std::accumulate(slab_volume.begin(), slab_volume.end(), 0l);
+    }
+
+    struct reactor {
+        std::vector<instruction> instructions;
+
+        [[nodiscard]] long volume(volume_mode mode, std::optional<cube> clip = std::nullopt) const {
+            std::vector<instruction> clipped;
+            const std::vector<instruction>* source = &instructions;
+            if (clip) {
+                for (instruction inst : instructions) {
+                    static_cast<cube&>(inst) = inst * *clip;
+                    if (inst.valid())
+                        clipped.push_back(inst);
+                }
+                source = &clipped;
+            }
+            switch (mode) {
+                case volume_mode::signed_cuboids: return signed_volume(*source);
+                case volume_mode::sweep: return sweep_volume(*source);
+            }
+            return 0;
+        }
+    };
+
+    std::vector<instruction> random_instructions(long count) {
+        std::mt19937 gen(22);
+        std::uniform_int_distribution<long> corner(-100'000, 100'000);
+        std::uniform_int_distribution<long> width(1, 20'000);
+        std::bernoulli_distribution on(0.6);
+        std::vector<instruction> to_return(static_cast<size_t>(count));
+        for (instruction& inst : to_return) {
+            inst.x1 = corner(gen), inst.y1 = corner(gen), inst.z1 = corner(gen);
+            inst.x2 = inst.x1 + width(gen), inst.y2 = inst.y1 + width(gen), inst.z2 = inst.z1 + width(gen);
+            inst.on = on(gen);
+        }
+        return to_return;
+    }
+
+    reactor get_reactor(puzzle_options filename) {
+        if (auto size = benchmark_size(filename))
+            return {random_instructions(*size)};
+        auto input = get_stream<instruction>(filename);
+        return {std::vector(input.begin(), input.end())};
+    }
+
+    // Benchmark runs also report which mode was used and how long it took
+    long timed_volume(puzzle_options filename, const reactor& r, volume_mode mode,
+                      std::optional<cube> clip = std::nullopt) {
+        auto start = std::chrono::steady_clock::now();
+        long total_area = r.volume(mode, clip);
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        if (benchmark_size(filename)) {
+            myprintf("Total volume is %ld (%s, %.3f ms)\n",
+                     total_area,
+                     mode == volume_mode::sweep ? "sweep" : "signed cuboids",
+                     elapsed.count());
+        } else {
+            myprintf("Total volume is %ld\n", total_area);
         }
-        myprintf("Total volume is %ld\n", total_area);
         return total_area;
     }
 
     answertype puzzle1(puzzle_options filename) {
-        auto input = get_stream<instruction>(filename);
-        instructions = std::vector(input.begin(), input.end());
-        return solve(true);
+        return timed_volume(filename, get_reactor(filename), volume_mode::signed_cuboids, bounds<50>);
     }
 
-    answertype puzzle2([[maybe_unused]] puzzle_options filename) {
-        return solve();
+    answertype puzzle2(puzzle_options filename) {
+        auto r = get_reactor(filename);
+        long total_area = timed_volume(filename, r, volume_mode::signed_cuboids);
+        if (benchmark_size(filename) && timed_volume(filename, r, volume_mode::sweep) != total_area) {
+            myprintf("The sweep and signed cuboid volumes differ\n");
+            return {};
+        }
+        return total_area;
     }
-} // namespace aoc2021::day22
\ No newline at end of file
+} // namespace aoc2021::day22
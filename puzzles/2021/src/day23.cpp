@@ -1,209 +1,244 @@
 #include "../../../common.h"
-#include <set>
-#include <map>
+#include <cassert>
 #include <numeric>
 #include "ox/graph.h"
-#include "ox/grid.h"
 
 #define DAY 23
 
 namespace aoc2021::day23 {
-    template<size_t Depth>
-    struct cave_state {
-        using cave = std::array<char, Depth>;
-        std::array<char, 11> hallway{};
-        std::array<cave, 4> caves;
-
-        cave_state(std::initializer_list<char> a, std::initializer_list<char> b, std::initializer_list<char> c, std::initializer_list<char> d) {
-            stdr::copy(a, caves[0].begin());
-            stdr::copy(b, caves[1].begin());
-            stdr::copy(c, caves[2].begin());
-            stdr::copy(d, caves[3].begin());
+    constexpr int hallway_length = 11;
+    constexpr std::array hallway_stops{0, 1, 3, 5, 7, 9, 10};
+    constexpr int stop_count = hallway_stops.size();
+    constexpr int room_count = 4;
+    constexpr int bits_per_slot = 3;
+    constexpr int max_depth = (128 / bits_per_slot - stop_count) / room_count;
+    constexpr std::array<std::string_view, 2> folded_rows{"  #D#C#B#A#", "  #D#B#A#C#"};
+
+    // Each slot holds 0 when empty or 1 + the amphipod type. The 7 hallway stops come first,
+    // followed by every room from its top position down.
+    struct burrow {
+        unsigned __int128 slots = 0;
+        int depth = 0;
+
+        [[nodiscard]] int get(int slot) const { return static_cast<int>(slots >> (bits_per_slot * slot)) & 0b111; }
+        void set(int slot, int value) {
+            slots &= ~(static_cast<unsigned __int128>(0b111) << (bits_per_slot * slot));
+            slots |= static_cast<unsigned __int128>(value) << (bits_per_slot * slot);
         }
-        bool operator<=>(const cave_state& other) const = default;
-    };
 
-    struct cave_state_hash {
-        template<size_t Depth>
-        size_t operator()(const day23::cave_state<Depth>& x) const {
-            size_t to_return = 0;
-            for (size_t i = 0; i < x.hallway.size(); i++) {
-                to_return += (i + 2) * (std::hash<char>()(x.hallway[i]) + i * 13);
-            }
-            for (size_t i = 0; i < x.caves.size(); i++) {
-                for (size_t j = 0; j < Depth; j++) {
-                    to_return += (i + 3) * (j + 5) * (std::hash<char>()(x.caves[i][j]) + i * 17 + j * 23);
+        [[nodiscard]] int room_slot(int room, int position) const { return stop_count + room * depth + position; }
+        [[nodiscard]] int hallway(int stop) const { return get(stop); }
+        [[nodiscard]] int room(int room, int position) const { return get(room_slot(room, position)); }
+
+        [[nodiscard]] burrow sorted() const {
+            burrow to_return{.depth = depth};
+            for (int r = 0; r < room_count; ++r) {
+                for (int p = 0; p < depth; ++p) {
+                    to_return.set(to_return.room_slot(r, p), r + 1);
                 }
             }
             return to_return;
         }
-    };
 
-    int cost_multiplier(char c) {
-        switch (c) {
-            case 'A': return 1;
-            case 'B': return 10;
-            case 'C': return 100;
-            case 'D': return 1000;
-            default: return 0;
+        bool operator==(const burrow&) const = default;
+    };
+} // namespace aoc2021::day23
+
+namespace std {
+    template <>
+    struct hash<aoc2021::day23::burrow> {
+        size_t operator()(const aoc2021::day23::burrow& b) const {
+            auto x = static_cast<uint64_t>(b.slots) ^ (static_cast<uint64_t>(b.slots >> 64) * 0x9e3779b97f4a7c15ull);
+            x ^= x >> 31;
+            x *= 0xbf58476d1ce4e5b9ull;
+            x ^= x >> 29;
+            return x;
         }
+    };
+} // namespace std
+
+namespace aoc2021::day23 {
+    long cost_multiplier(int amphipod) {
+        constexpr std::array<long, 5> costs{0, 1, 10, 100, 1000};
+        return costs[amphipod];
     }
 
-    template<int Depth>
-    std::vector<std::pair<cave_state<Depth>, long>> get_neighbour_states(const cave_state<Depth>& c) {
-        std::vector<std::pair<cave_state<Depth>, long>> to_return;
-
-        constexpr std::array end_steps{0, 1, 3, 5, 7, 9, 10};
-        auto not_empty = stdv::filter([&c](auto i) { return c.hallway[i] != '\0'; });
-        auto still_empty = stdv::take_while([&c](auto i) { return c.hallway[i] == '\0'; });
-
-        auto into_cave = [&](int index_from, char type) {
-            auto cpy = c;
-            auto& in_cave = cpy.caves[type - 'A'];
-            auto non_correct = std::find_if(in_cave.rbegin(), in_cave.rend(), [type](char c) { return c != type; });
-            bool correct = std::all_of(non_correct, in_cave.rend(), [](char c) { return c == '\0'; });
-            if (correct) {
-                std::swap(cpy.hallway[index_from], *non_correct);
-                to_return.push_back(
-                       std::make_pair(
-                              cpy,
-                              cost_multiplier(type) * (std::abs(index_from - 2 * (type - 'A' + 1)) + (non_correct.base() - in_cave.begin()))));
-            }
-        };
-
-        auto from_cave = [&](int index_to, int cave_id, int cave_index) {
-            if (c.hallway[index_to])
-                return;
-            auto cpy = c;
-            std::swap(cpy.hallway[index_to], cpy.caves[cave_id][cave_index]);
-            to_return.push_back(
-                   std::make_pair(
-                          cpy,
-                          cost_multiplier(cpy.hallway[index_to]) * (cave_index + 1 + std::abs(index_to - 2 * (cave_id + 1)))));
-        };
+    int door_position(int room) {
+        return 2 * (room + 1);
+    }
+
+    struct neighbour_list {
+        using value_type = std::pair<burrow, long>;
+        std::array<value_type, stop_count * room_count> moves;
+        size_t count = 0;
+
+        void emplace_back(const burrow& b, long cost) { moves[count++] = {b, cost}; }
+        [[nodiscard]] auto begin() const { return moves.begin(); }
+        [[nodiscard]] auto end() const { return moves.begin() + static_cast<ptrdiff_t>(count); }
+        [[nodiscard]] size_t size() const { return count; }
+        [[nodiscard]] bool empty() const { return count == 0; }
+    };
+
+    bool hallway_clear(const burrow& b, int from_x, int to_x) {
+        auto [lo, hi] = std::minmax(from_x, to_x);
+        return stdr::none_of(stdv::iota(0, stop_count), [&](int stop) {
+            return hallway_stops[stop] > lo && hallway_stops[stop] < hi && b.hallway(stop);
+        });
+    }
+
+    // Position of the first amphipod from the top, or depth if the room is empty
+    int room_top(const burrow& b, int room) {
+        int p = 0;
+        while (p < b.depth && !b.room(room, p))
+            ++p;
+        return p;
+    }
+
+    bool room_settled(const burrow& b, int room, int from) {
+        return stdr::all_of(stdv::iota(from, b.depth), [&](int p) { return b.room(room, p) == room + 1; });
+    }
+
+    neighbour_list get_neighbour_states(const burrow& b) {
+        neighbour_list to_return;
 
         // Move from hallway into cave
-        for (auto hallway_position : end_steps | not_empty) {
-            char crab = c.hallway[hallway_position];
-            int target = (crab - 'A' + 1) * 2;
-            if (target > hallway_position) {
-                if (stdr::all_of(stdv::iota(hallway_position + 1, target + 1), [&](int i) { return !c.hallway[i]; })) {
-                    into_cave(hallway_position, crab);
-                }
-            } else {
-                if (stdr::all_of(stdv::iota(target, hallway_position), [&](int i) { return !c.hallway[i]; })) {
-                    into_cave(hallway_position, crab);
-                }
-            }
+        for (int stop = 0; stop < stop_count; ++stop) {
+            int amphipod = b.hallway(stop);
+            if (!amphipod)
+                continue;
+            int room = amphipod - 1;
+            int top = room_top(b, room);
+            if (top == 0 || !room_settled(b, room, top) || !hallway_clear(b, hallway_stops[stop], door_position(room)))
+                continue;
+            burrow next = b;
+            next.set(stop, 0);
+            next.set(next.room_slot(room, top - 1), amphipod);
+            to_return.emplace_back(next,
+                                   cost_multiplier(amphipod)
+                                           * (std::abs(hallway_stops[stop] - door_position(room)) + top));
         }
 
-        if (to_return.empty()) {
-            // Move from cave
-            for (auto& cave : c.caves | ox::ranges::views::iterators) {
-                auto top = std::find_if(cave->begin(), cave->end(), std::identity());
-                if (std::all_of(top, cave->end(), [&](char crab) { return crab == 'A' + (cave - c.caves.begin()); }))
+        if (!to_return.empty())
+            return to_return;
+
+        // Move from cave
+        for (int room = 0; room < room_count; ++room) {
+            int top = room_top(b, room);
+            if (room_settled(b, room, top))
+                continue;
+            int amphipod = b.room(room, top);
+            for (int stop = 0; stop < stop_count; ++stop) {
+                if (b.hallway(stop) || !hallway_clear(b, hallway_stops[stop], door_position(room)))
                     continue;
-                if (top != cave->end()) {
-                    int index = cave - c.caves.begin();
-                    int hallway_index = 2 * (index + 1);
-                    auto middle = stdr::find_if(end_steps, [=](int i) { return i > hallway_index; });
-                    for (int x : stdr::subrange(middle, end_steps.end()) | still_empty) {
-                        from_cave(x, index, top - cave->begin());
-                    }
-                    for (int x : stdr::subrange(end_steps.begin(), middle) | stdv::reverse | still_empty) {
-                        from_cave(x, index, top - cave->begin());
-                    }
-                }
+                burrow next = b;
+                next.set(next.room_slot(room, top), 0);
+                next.set(stop, amphipod);
+                to_return.emplace_back(next,
+                                       cost_multiplier(amphipod)
+                                               * (top + 1 + std::abs(hallway_stops[stop] - door_position(room))));
             }
         }
 
         return to_return;
     }
 
-    template<int Depth>
-    long heuristic_distance_to_end(const cave_state<Depth>& state, const cave_state<Depth>&) {
-        constexpr std::array end_steps{0, 1, 3, 5, 7, 9, 10};
+    long heuristic_distance_to_end(const burrow& state, const burrow&) {
         long cost = 0;
 
-        for (int i = 0; i < state.caves.size(); i++) {
-            char type = 'A' + i;
-            int cave_x_position = (i + 1) * 2;
-
-            auto& cave = state.caves[i];
-            auto non_correct = std::find_if(cave.rbegin(), cave.rend(), [type](char c) { return c != type; });
-
-            for (auto x : stdr::subrange(non_correct, cave.rend()) | ox::ranges::views::iterators) {
-                int position = x.base() - cave.begin();
-                cost += cost_multiplier(*x) * position;
-                cost += cost_multiplier(type) * position;
-                cost += cost_multiplier(*x) * std::abs(cave_x_position - (*x - 'A' + 1) * 2);
+        for (int room = 0; room < room_count; ++room) {
+            int deepest_wrong = state.depth - 1;
+            while (deepest_wrong >= 0 && state.room(room, deepest_wrong) == room + 1)
+                --deepest_wrong;
+
+            for (int p = 0; p <= deepest_wrong; ++p) {
+                int amphipod = state.room(room, p);
+                int position = p + 1;
+                cost += cost_multiplier(amphipod) * position;
+                cost += cost_multiplier(room + 1) * position;
+                if (amphipod)
+                    cost += cost_multiplier(amphipod) * std::abs(door_position(room) - door_position(amphipod - 1));
             }
         }
 
-        for (auto x_pos : end_steps) {
-            if (char type = state.hallway[x_pos]; type) {
-                cost += cost_multiplier(type) * std::abs(x_pos - (type - 'A' + 1) * 2);
+        for (int stop = 0; stop < stop_count; ++stop) {
+            if (int amphipod = state.hallway(stop); amphipod) {
+                cost += cost_multiplier(amphipod) * std::abs(hallway_stops[stop] - door_position(amphipod - 1));
             }
         }
 
         return cost;
     }
 
-    template<int Depth>
-    void print_state(const cave_state<Depth>& cave) {
-        for (char c : cave.hallway) {
-            myprintf("%c", c ?: '.');
+    char amphipod_name(int amphipod) {
+        return amphipod ? static_cast<char>('A' + amphipod - 1) : '.';
+    }
+
+    void print_state(const burrow& b) {
+        std::string hallway(hallway_length, '.');
+        for (int stop = 0; stop < stop_count; ++stop) {
+            hallway[hallway_stops[stop]] = amphipod_name(b.hallway(stop));
         }
-        myprintf("\n");
-#define GET_CHR_(i, j) cave.caves[i][j] ?: '.'
-        for (int i : stdv::iota(0, Depth)) {
-            myprintf("  %c %c %c %c\n", GET_CHR_(0, i), GET_CHR_(1, i), GET_CHR_(2, i), GET_CHR_(3, i));
+        myprintf("%s\n", hallway.c_str());
+        for (int p = 0; p < b.depth; ++p) {
+            myprintf("  %c %c %c %c\n",
+                     amphipod_name(b.room(0, p)),
+                     amphipod_name(b.room(1, p)),
+                     amphipod_name(b.room(2, p)),
+                     amphipod_name(b.room(3, p)));
         }
-#undef GET_CHR_
     }
 
-    answertype puzzle1([[maybe_unused]] puzzle_options filename) {
-        cave_state<2> part1({'C', 'B'}, {'A', 'A'}, {'B', 'D'}, {'D', 'C'});
+    int parse_amphipod(char c) {
+        return c >= 'A' && c <= 'D' ? c - 'A' + 1 : 0;
+    }
 
-        auto [path, cost] = ox::dikstra(
-               part1, cave_state<2>({'A', 'A'}, {'B', 'B'}, {'C', 'C'}, {'D', 'D'}),
-               get_neighbour_states<2>,
-               [](...) {
-                   return 0;
-               },
-               cave_state_hash());
+    // The second line is the hallway, every following line with room cells is one level of the rooms
+    burrow parse_burrow(const std::vector<std::string>& lines) {
+        std::vector<std::string_view> rows;
+        for (std::string_view line : lines | stdv::drop(2)) {
+            if (line.size() > 9 && line[3] != '#')
+                rows.push_back(line);
+        }
+        assert(rows.size() <= max_depth);
 
-        for (auto& [state, cost] : path) {
-            print_state<2>(state);
-            myprintf("Cost is %ld\n\n", cost);
+        burrow to_return{.depth = static_cast<int>(rows.size())};
+        for (int stop = 0; stop < stop_count; ++stop) {
+            to_return.set(stop, parse_amphipod(lines[1][1 + hallway_stops[stop]]));
         }
-        myprintf("Cost is %ld\n", cost);
-        return cost;
+        for (int p = 0; p < to_return.depth; ++p) {
+            for (int room = 0; room < room_count; ++room) {
+                to_return.set(to_return.room_slot(room, p), parse_amphipod(rows[p][1 + door_position(room)]));
+            }
+        }
+        return to_return;
     }
 
-    answertype puzzle2([[maybe_unused]] puzzle_options filename) {
-        cave_state<4> part2(
-               {'C', 'D', 'D', 'B'},
-               {'A', 'C', 'B', 'A'},
-               {'B', 'B', 'A', 'D'},
-               {'D', 'A', 'C', 'C'});
-        cave_state<4> test(
-               {'B', 'D', 'D', 'A'},
-               {'C', 'C', 'B', 'D'},
-               {'B', 'B', 'A', 'C'},
-               {'D', 'A', 'C', 'A'});
-
-        auto [path, cost] = ox::dikstra(
-               part2, cave_state<4>({'A', 'A', 'A', 'A'}, {'B', 'B', 'B', 'B'}, {'C', 'C', 'C', 'C'}, {'D', 'D', 'D', 'D'}),
-               get_neighbour_states<4>,
-               [](...) { return 0; },
-               cave_state_hash());
+    std::vector<std::string> get_lines(puzzle_options filename) {
+        auto stream = get_stream<ox::line>(filename);
+        return {stream.begin(), stream.end()};
+    }
+
+    long solve(const burrow& start) {
+        ox::dikstra_solver solver(
+                ox::a_start(), start, start.sorted(), get_neighbour_states, heuristic_distance_to_end);
+        solver.track_path();
+        auto [path, cost] = solver();
 
         for (auto& [state, cost] : path) {
-            print_state<4>(state);
+            print_state(state);
             myprintf("Cost is %ld\n\n", cost);
         }
         myprintf("Cost is %ld\n", cost);
         return cost;
     }
-} // namespace aoc2021::day23
\ No newline at end of file
+
+    answertype puzzle1(puzzle_options filename) {
+        return solve(parse_burrow(get_lines(filename)));
+    }
+
+    answertype puzzle2(puzzle_options filename) {
+        auto lines = get_lines(filename);
+        lines.insert(lines.begin() + 3, folded_rows.begin(), folded_rows.end());
+        return solve(parse_burrow(lines));
+    }
+} // namespace aoc2021::day23
@@ -4,8 +4,9 @@
 #include "ox/debug.h"
 #include <numeric>
 #include <stack>
-#include <cassert>
 #include <ranges>
+#include <thread>
+#include <unordered_set>
 
 #define DAY  24
 
@@ -22,11 +23,6 @@ namespace aoc2021::day24 {
         bool literal;
     };
 
-    static std::vector<instruction> instructions;
-    static std::vector<char> As;
-    static std::vector<int> Bs;
-    static std::vector<int> Cs;
-
 #define CALL_NEXT() \
   if (instruction_iter == instructions.end()) \
     goto end; \
@@ -36,29 +32,6 @@ namespace aoc2021::day24 {
 #define GET_SOURCE() \
   (current_instruction.literal ? current_instruction.source_lit : registers[current_instruction.source_reg])
 
-    const char* opcode_name(opcode op) {
-        switch (op) {
-            case INP: return "inp";
-            case ADD: return "add";
-            case MUL: return "mul";
-            case DIV: return "div";
-            case MOD: return "mod";
-            case EQL: return "eql";
-            case SET: return "set";
-        }
-        return nullptr;
-    }
-
-    char variable_name(variable v) {
-        switch (v) {
-            case W: return 'w';
-            case X: return 'x';
-            case Y: return 'y';
-            case Z: return 'z';
-        }
-        return 0;
-    }
-
     opcode from_char(const char type[]) {
         if (type[0] == 'i')
             return INP;
@@ -80,8 +53,7 @@ namespace aoc2021::day24 {
      * ===============================================
      */
     template <stdr::forward_range InstructionRange, stdr::input_range InputRange>
-    std::array<long, 4> simulate(InstructionRange instructions, InputRange inputs) {
-        std::array<long, 4> registers{};
+    std::array<long, 4> simulate(InstructionRange instructions, InputRange inputs, std::array<long, 4> registers = {}) {
         auto instruction_iter = instructions.begin();
         auto inputs_iter = inputs.begin();
         static void* jump_table[] = {&&inp, &&add, &&mul, &&div, &&mod, &&eql, &&set};
@@ -113,313 +85,84 @@ namespace aoc2021::day24 {
         return registers;
     }
 
-    std::array<long, 4> simulate(stdr::random_access_range auto& input) {
-        long w = 0, x = 0, y = 0, z = 0;
-        auto in = input.begin();
-        w = *in++;
-        x *= 0;
-        x += z;
-        x %= 26;
-        z /= 1;
-        x += 11;
-        x = x == w;
-        x = x == 0;
-        y *= 0;
-        y += 25;
-        y *= x;
-        y += 1;
-        z *= y;
-        y *= 0;
-        y += w;
-        y += 8;
-        y *= x;
-        z += y;
-        w = *in++;
-        x *= 0;
-        x += z;
-        x %= 26;
-        z /= 1;
-        x += 14;
-        x = x == w;
-        x = x == 0;
-        y *= 0;
-        y += 25;
-        y *= x;
-        y += 1;
-        z *= y;
-        y *= 0;
-        y += w;
-        y += 13;
-        y *= x;
-        z += y;
-        w = *in++;
-        x *= 0;
-        x += z;
-        x %= 26;
-        z /= 1;
-        x += 10;
-        x = x == w;
-        x = x == 0;
-        y *= 0;
-        y += 25;
-        y *= x;
-        y += 1;
-        z *= y;
-        y *= 0;
-        y += w;
-        y += 2;
-        y *= x;
-        z += y;
-        w = *in++;
-        x *= 0;
-        x += z;
-        x %= 26;
-        z /= 26;
-        x += 0;
-        x = x == w;
-        x = x == 0;
-        y *= 0;
-        y += 25;
-        y *= x;
-        y += 1;
-        z *= y;
-        y *= 0;
-        y += w;
-        y += 7;
-        y *= x;
-        z += y;
-        w = *in++;
-        x *= 0;
-        x += z;
-        x %= 26;
-        z /= 1;
-        x += 12;
-        x = x == w;
-        x = x == 0;
-        y *= 0;
-        y += 25;
-        y *= x;
-        y += 1;
-        z *= y;
-        y *= 0;
-        y += w;
-        y += 11;
-        y *= x;
-        z += y;
-        w = *in++;
-        x *= 0;
-        x += z;
-        x %= 26;
-        z /= 1;
-        x += 12;
-        x = x == w;
-        x = x == 0;
-        y *= 0;
-        y += 25;
-        y *= x;
-        y += 1;
-        z *= y;
-        y *= 0;
-        y += w;
-        y += 4;
-        y *= x;
-        z += y;
-        w = *in++;
-        x *= 0;
-        x += z;
-        x %= 26;
-        z /= 1;
-        x += 12;
-        x = x == w;
-        x = x == 0;
-        y *= 0;
-        y += 25;
-        y *= x;
-        y += 1;
-        z *= y;
-        y *= 0;
-        y += w;
-        y += 13;
-        y *= x;
-        z += y;
-        w = *in++;
-        x *= 0;
-        x += z;
-        x %= 26;
-        z /= 26;
-        x += -8;
-        x = x == w;
-        x = x == 0;
-        y *= 0;
-        y += 25;
-        y *= x;
-        y += 1;
-        z *= y;
-        y *= 0;
-        y += w;
-        y += 13;
-        y *= x;
-        z += y;
-        w = *in++;
-        x *= 0;
-        x += z;
-        x %= 26;
-        z /= 26;
-        x += -9;
-        x = x == w;
-        x = x == 0;
-        y *= 0;
-        y += 25;
-        y *= x;
-        y += 1;
-        z *= y;
-        y *= 0;
-        y += w;
-        y += 10;
-        y *= x;
-        z += y;
-        w = *in++;
-        x *= 0;
-        x += z;
-        x %= 26;
-        z /= 1;
-        x += 11;
-        x = x == w;
-        x = x == 0;
-        y *= 0;
-        y += 25;
-        y *= x;
-        y += 1;
-        z *= y;
-        y *= 0;
-        y += w;
-        y += 1;
-        y *= x;
-        z += y;
-        w = *in++;
-        x *= 0;
-        x += z;
-        x %= 26;
-        z /= 26;
-        x += 0;
-        x = x == w;
-        x = x == 0;
-        y *= 0;
-        y += 25;
-        y *= x;
-        y += 1;
-        z *= y;
-        y *= 0;
-        y += w;
-        y += 2;
-        y *= x;
-        z += y;
-        w = *in++;
-        x *= 0;
-        x += z;
-        x %= 26;
-        z /= 26;
-        x += -5;
-        x = x == w;
-        x = x == 0;
-        y *= 0;
-        y += 25;
-        y *= x;
-        y += 1;
-        z *= y;
-        y *= 0;
-        y += w;
-        y += 14;
-        y *= x;
-        z += y;
-        w = *in++;
-        x *= 0;
-        x += z;
-        x %= 26;
-        z /= 26;
-        x += -6;
-        x = x == w;
-        x = x == 0;
-        y *= 0;
-        y += 25;
-        y *= x;
-        y += 1;
-        z *= y;
-        y *= 0;
-        y += w;
-        y += 6;
-        y *= x;
-        z += y;
-        w = *in++;
-        x *= 0;
-        x += z;
-        x %= 26;
-        z /= 26;
-        x += -12;
-        x = x == w;
-        x = x == 0;
-        y *= 0;
-        y += 25;
-        y *= x;
-        y += 1;
-        z *= y;
-        y *= 0;
-        y += w;
-        y += 14;
-        y *= x;
-        z += y;
-        return {w, x, y, z};
-    }
-
-    long new_z0(bool a, long b, long c, long input, long z) {
-        long w = 0, x = 0, y = 0;
-        w = input;
-        x *= 0l;
-        x += z;
-        x %= 26l;
-        z /= a ? 1l : 26l;
-        x += b;
-        x = x == w;
-        x = x == 0;
-        y *= 0l;
-        y += 25l;
-        y *= x;
-        y += 1;
-        z *= y;
-        y *= 0l;
-        y += w;
-        y += c;
-        y *= x;
-        z += y;
-        return z;
-    }
-
-    long new_raw(bool a, long b, long c, long input, long z) {
-        bool x = z % 26l != input - b;
-        z /= a ? 1l : 26l;
-        z *= x ? 26l : 1l;
-        z += x ? (input + c) : 0l;
-        return z;
-    }
+    /* ================================================
+     * BATCHED BYTE CODE SIMULATION
+     * ===============================================
+     */
+    // Runs Lanes independent inputs through the program at once. Every instruction becomes a fixed length
+    // loop over the lanes, which the compiler turns into vector instructions for everything but div and mod.
+    template <size_t Lanes>
+    using lanes = std::array<long, Lanes>;
+
+    template <size_t Lanes>
+    std::array<lanes<Lanes>, 4> simulate_lanes(const std::vector<instruction>& instructions,
+                                               const std::vector<lanes<Lanes>>& inputs) {
+        std::array<lanes<Lanes>, 4> registers{};
+        auto inputs_iter = inputs.begin();
+        for (const instruction& inst : instructions) {
+            auto& dest = registers[inst.dest];
+            if (inst.op == INP) {
+                dest = *inputs_iter++;
+                continue;
+            }
+            lanes<Lanes> source;
+            if (inst.literal)
+                source.fill(inst.source_lit);
+            else
+                source = registers[inst.source_reg];
 
-    void print_stack(long z) {
-        for (long i = z; i > 0l; i /= 26l) {
-            myprintf("%ld ", i % 26l);
+            switch (inst.op) {
+                case ADD:
+                    for (size_t l = 0; l < Lanes; ++l)
+                        dest[l] += source[l];
+                    break;
+                case MUL:
+                    for (size_t l = 0; l < Lanes; ++l)
+                        dest[l] *= source[l];
+                    break;
+                case DIV:
+                    for (size_t l = 0; l < Lanes; ++l)
+                        dest[l] /= source[l];
+                    break;
+                case MOD:
+                    for (size_t l = 0; l < Lanes; ++l)
+                        dest[l] %= source[l];
+                    break;
+                case EQL:
+                    for (size_t l = 0; l < Lanes; ++l)
+                        dest[l] = dest[l] == source[l];
+                    break;
+                case SET: dest = source; break;
+                case INP: break;
+            }
         }
-        myprintf("\n");
+        return registers;
     }
 
-    long new_z_debug(bool a, long b, long c, long input, long z) {
-        long next = new_raw(a, b, c, input, z);
-        myprintf("\033[%dm", a ? 0 : 31);
-        myprintf("\t%ld\n", next);
-        print_stack(z);
-        myprintf("\033[0m");
-        return z;
+    template <size_t Lanes = 16>
+    std::vector<bool> verify_inputs(const std::vector<instruction>& instructions,
+                                    const std::vector<std::vector<long>>& candidates) {
+        std::vector<bool> to_return;
+        to_return.reserve(candidates.size());
+        for (size_t first = 0; first < candidates.size(); first += Lanes) {
+            size_t count = std::min(Lanes, candidates.size() - first);
+            std::vector<lanes<Lanes>> inputs(candidates[first].size());
+            for (size_t digit = 0; digit < inputs.size(); ++digit) {
+                for (size_t l = 0; l < Lanes; ++l) {
+                    inputs[digit][l] = candidates[first + std::min(l, count - 1)][digit];
+                }
+            }
+            auto z = simulate_lanes<Lanes>(instructions, inputs)[Z];
+            for (size_t l = 0; l < count; ++l) {
+                to_return.push_back(z[l] == 0);
+            }
+        }
+        return to_return;
     }
 
+    // Pairs every pushed digit with the digit that pops it. Fails when a pair's offset leaves no digits that match.
     template <bool Min = false>
-    std::vector<long> get_valid_input(const std::vector<char>& a, const std::vector<int>& b,
+    std::optional<std::vector<long>> get_valid_input(const std::vector<char>& a, const std::vector<int>& b,
                                       const std::vector<int>& c) {
         std::stack<std::pair<int, int>> s;
         std::vector<long> to_return(a.size());
@@ -433,29 +176,27 @@ namespace aoc2021::day24 {
                 s.pop();
 
                 int sum = *bItr + c_val;
+                if (sum <= -9 || sum >= 9)
+                    return std::nullopt;
                 if constexpr (Min) {
                     if (sum < 0) {
-                        assert(sum > -9);
                         to_return[p_index] = 1 - sum;
                         to_return[c_index] = 1;
                     } else if (sum == 0) {
                         to_return[p_index] = 1;
                         to_return[c_index] = 1;
                     } else if (sum > 0) {
-                        assert(sum < 9);
                         to_return[p_index] = 1;
                         to_return[c_index] = 1 + sum;
                     }
                 } else {
                     if (sum < 0) {
-                        assert(sum > -9);
                         to_return[p_index] = 9;
                         to_return[c_index] = 9 + sum;
                     } else if (sum == 0) {
                         to_return[p_index] = 9;
                         to_return[c_index] = 9;
                     } else if (sum > 0) {
-                        assert(sum < 9);
                         to_return[p_index] = 9 - sum;
                         to_return[c_index] = 9;
                     }
@@ -486,65 +227,319 @@ namespace aoc2021::day24 {
     }
 
     /* ================================================
-     * BYTE CODE PRINTING
+     * BLOCK ANALYSIS
      * ===============================================
      */
+    using registers = std::array<long, 4>;
+    constexpr long digit_min = 1;
+    constexpr long digit_max = 9;
+    constexpr long range_limit = 1l << 60;
+    constexpr long unbounded_lo = std::numeric_limits<long>::min();
+    constexpr long unbounded_hi = std::numeric_limits<long>::max();
+
+    struct registers_hash {
+        size_t operator()(const registers& r) const {
+            return std::hash<std::string_view>()(std::string_view(reinterpret_cast<const char*>(&r), sizeof(r)));
+        }
+    };
 
-    void print_instruction(const instruction& inst) {
-        myprintf("%s %c", opcode_name(inst.op), variable_name(inst.dest));
-        if (inst.op != INP) {
-            if (inst.literal)
-                myprintf(" %d", inst.source_lit);
-            else
-                myprintf(" %c", variable_name(inst.source_reg));
+    // The usual MONAD digit block, reduced to its constants:
+    // x = (z % mod + b) != w; z /= div; if (x) z = z * mul + w + c
+    struct digit_check {
+        long mod, div, b, mul, c;
+    };
+
+    std::optional<digit_check> specialize(const std::vector<instruction>& code) {
+        constexpr int any = std::numeric_limits<int>::min();
+        struct pattern {
+            opcode op;
+            variable dest;
+            bool literal;
+            int source;
+        };
+        static constexpr std::array<pattern, 18> shape{
+                {{INP, W, false, W},
+                 {MUL, X, true, 0},
+                 {ADD, X, false, Z},
+                 {MOD, X, true, any},
+                 {DIV, Z, true, any},
+                 {ADD, X, true, any},
+                 {EQL, X, false, W},
+                 {EQL, X, true, 0},
+                 {MUL, Y, true, 0},
+                 {ADD, Y, true, any},
+                 {MUL, Y, false, X},
+                 {ADD, Y, true, 1},
+                 {MUL, Z, false, Y},
+                 {MUL, Y, true, 0},
+                 {ADD, Y, false, W},
+                 {ADD, Y, true, any},
+                 {MUL, Y, false, X},
+                 {ADD, Z, false, Y}}
+        };
+
+        if (code.size() != shape.size())
+            return {};
+        for (size_t i = 0; i < shape.size(); ++i) {
+            const instruction& inst = code[i];
+            const pattern& p = shape[i];
+            if (inst.op != p.op || inst.dest != p.dest)
+                return {};
+            if (inst.op == INP)
+                continue;
+            if (inst.literal != p.literal)
+                return {};
+            if (!inst.literal && inst.source_reg != p.source)
+                return {};
+            if (inst.literal && p.source != any && inst.source_lit != p.source)
+                return {};
         }
+        return digit_check{.mod = code[3].source_lit,
+                           .div = code[4].source_lit,
+                           .b = code[5].source_lit,
+                           .mul = code[9].source_lit + 1l,
+                           .c = code[15].source_lit};
     }
 
-    void print_instructions(const std::vector<instruction>& instructions) {
-        for (const instruction& inst : instructions) {
-            print_instruction(inst);
-            myprintf("\n");
+    // Value ranges. A bound that gets past +-range_limit saturates to unbounded, so the exact bounds stay far
+    // enough from the limits of long that the arithmetic on them cannot overflow, and a saturated bound is never
+    // mistaken for an exact one.
+    struct range {
+        long lo = 0, hi = 0;
+
+        static range clamp(__int128 lo, __int128 hi) {
+            return {lo < -range_limit ? unbounded_lo : static_cast<long>(std::min<__int128>(lo, range_limit)),
+                    hi > range_limit ? unbounded_hi : static_cast<long>(std::max<__int128>(hi, -range_limit))};
         }
-    }
+        static constexpr range unbounded() { return {unbounded_lo, unbounded_hi}; }
+        [[nodiscard]] bool contains(long v) const { return lo <= v && v <= hi; }
+    };
+    using abstract_registers = std::array<range, 4>;
 
-    void print_as_c(const std::vector<instruction>& instructions) {
-        myprintf("std::array<long, 4> simulate(const std::array<char, 14>& "
-               "input) {");
-        myprintf("int w, x, y, z;"
-               "auto in = input.begin();");
-        for (const instruction& inst : instructions) {
-            switch (inst.op) {
-                case INP: myprintf("%c = *in++", variable_name(inst.dest)); break;
-                case ADD:
-                    myprintf("%c +=", variable_name(inst.dest));
-                    inst.literal ? myprintf(" %d", inst.source_lit) : myprintf(" %c", variable_name(inst.source_reg));
-                    break;
-                case MUL:
-                    myprintf("%c *=", variable_name(inst.dest));
-                    inst.literal ? myprintf(" %d", inst.source_lit) : myprintf(" %c", variable_name(inst.source_reg));
-                    break;
-                case DIV:
-                    myprintf("%c /=", variable_name(inst.dest));
-                    inst.literal ? myprintf(" %d", inst.source_lit) : myprintf(" %c", variable_name(inst.source_reg));
-                    break;
-                case MOD:
-                    myprintf("%c %%=", variable_name(inst.dest));
-                    inst.literal ? myprintf(" %d", inst.source_lit) : myprintf(" %c", variable_name(inst.source_reg));
-                    break;
-                case EQL:
-                    myprintf("%c = %c == ", variable_name(inst.dest), variable_name(inst.dest));
-                    inst.literal ? myprintf(" %d", inst.source_lit) : myprintf(" %c", variable_name(inst.source_reg));
-                    break;
-                case SET:
-                    myprintf("%c =", variable_name(inst.dest));
-                    inst.literal ? myprintf(" %d", inst.source_lit) : myprintf(" %c", variable_name(inst.source_reg));
-                    break;
+    range apply(opcode op, range a, range b) {
+        switch (op) {
+            case INP: return {digit_min, digit_max};
+            case ADD: return range::clamp(__int128{a.lo} + b.lo, __int128{a.hi} + b.hi);
+            case MUL: {
+                std::array<__int128, 4> corners{
+                        __int128{a.lo} * b.lo, __int128{a.lo} * b.hi, __int128{a.hi} * b.lo, __int128{a.hi} * b.hi};
+                auto [lo, hi] = stdr::minmax(corners);
+                return range::clamp(lo, hi);
             }
-            myprintf(";");
+            case DIV: {
+                if (b.contains(0))
+                    return range::unbounded();
+                std::array<__int128, 4> corners{
+                        __int128{a.lo} / b.lo, __int128{a.lo} / b.hi, __int128{a.hi} / b.lo, __int128{a.hi} / b.hi};
+                auto [lo, hi] = stdr::minmax(corners);
+                return range::clamp(lo, hi);
+            }
+            case MOD: {
+                long bound = std::max(b.lo == unbounded_lo ? unbounded_hi : std::abs(b.lo), std::abs(b.hi)) - 1;
+                if (a.lo >= 0 && b.lo > 0 && a.hi < b.lo)
+                    return a;
+                return {a.lo < 0 ? std::max(a.lo, -bound) : 0, a.hi > 0 ? std::min(a.hi, bound) : 0};
+            }
+            case EQL:
+                if (a.lo == a.hi && b.lo == b.hi && a.lo == b.lo)
+                    return {1, 1};
+                if (a.hi < b.lo || b.hi < a.lo)
+                    return {0, 0};
+                return {0, 1};
+            case SET: return b;
+        }
+        return range::unbounded();
+    }
+
+    abstract_registers abstract_run(const std::vector<instruction>& code, abstract_registers r) {
+        for (const instruction& inst : code) {
+            range source;
+            if (inst.op != INP)
+                source = inst.literal ? range{inst.source_lit, inst.source_lit} : r[inst.source_reg];
+            r[inst.dest] = apply(inst.op, r[inst.dest], source);
+        }
+        return r;
+    }
+
+    // Registers the code reads before writing them, and registers it writes
+    std::pair<unsigned, unsigned> uses_and_defs(const std::vector<instruction>& code) {
+        unsigned uses = 0, defs = 0;
+        auto read = [&](variable v) {
+            if (!(defs & (1u << v)))
+                uses |= 1u << v;
+        };
+        for (const instruction& inst : code) {
+            bool overwrites = inst.op == INP || inst.op == SET || (inst.op == MUL && inst.literal && inst.source_lit == 0);
+            if (inst.op != INP && !inst.literal)
+                read(inst.source_reg);
+            if (!overwrites)
+                read(inst.dest);
+            defs |= 1u << inst.dest;
+        }
+        return {uses, defs};
+    }
+
+    // Smallest t in [lo, hi] for which the monotone predicate holds, or hi + 1
+    long first_true(long lo, long hi, auto pred) {
+        while (lo <= hi) {
+            long mid = lo + (hi - lo) / 2;
+            if (pred(mid))
+                hi = mid - 1;
+            else
+                lo = mid + 1;
         }
-        myprintf("return {w, x, y, z};}");
+        return lo;
     }
 
+    struct block {
+        std::vector<instruction> code;
+        std::optional<digit_check> check;
+        unsigned live_in = 0;
+        range z_bounds = range::unbounded();
+
+        [[nodiscard]] registers run(registers r, long digit) const {
+            if (!check)
+                return simulate(stdv::all(code), std::array{digit}, r);
+            const digit_check& d = *check;
+            long x = (r[Z] % d.mod + d.b) != digit;
+            long z = r[Z] / d.div;
+            if (x)
+                z = z * d.mul + digit + d.c;
+            return {digit, x, x * (digit + d.c), z};
+        }
+
+        [[nodiscard]] registers normalize(registers r) const {
+            for (int v = W; v <= Z; ++v) {
+                if (!(live_in & (1u << v)))
+                    r[v] = 0;
+            }
+            return r;
+        }
+
+        [[nodiscard]] bool admits(const registers& r) const { return z_bounds.contains(r[Z]); }
+    };
+
+    struct monad {
+        std::vector<instruction> instructions;
+        std::vector<block> blocks;
+
+        explicit monad(std::vector<instruction> program) : instructions(std::move(program)) {
+            for (auto& code : split_code(instructions)) {
+                auto check = specialize(code);
+                blocks.push_back({.code = std::move(code), .check = check});
+            }
+            analyse_liveness();
+            analyse_ranges();
+        }
+
+        // A register only has to be part of a memoized state if some later block may read it
+        void analyse_liveness() {
+            unsigned live = 1u << Z;
+            for (auto& b : blocks | stdv::reverse) {
+                auto [uses, defs] = uses_and_defs(b.code);
+                b.live_in = uses | (live & ~defs);
+                live = b.live_in;
+            }
+        }
+
+        // Forward interval analysis gives the range of every register on entry to each block.
+        // Walking backwards from z == 0, each block then gets the range of z from which
+        // the remaining blocks can still reach a valid end state; anything outside is pruned. The search only covers
+        // +-range_limit, so a side on which it finds no cut stays unbounded.
+        void analyse_ranges() {
+            std::vector<abstract_registers> entry(blocks.size() + 1);
+            for (size_t i = 0; i < blocks.size(); ++i) {
+                entry[i + 1] = abstract_run(blocks[i].code, entry[i]);
+            }
+
+            range reachable{0, 0};
+            for (size_t i = blocks.size(); i-- > 0;) {
+                auto output_z = [&, probe = entry[i]](long lo, long hi) mutable {
+                    probe[Z] = {lo, hi};
+                    return abstract_run(blocks[i].code, probe)[Z];
+                };
+                long hi = first_true(-range_limit, range_limit, [&](long t) {
+                    return output_z(t, unbounded_hi).lo > reachable.hi;
+                });
+                long lo = first_true(-range_limit, range_limit, [&](long t) {
+                    return output_z(unbounded_lo, t).hi >= reachable.lo;
+                });
+                blocks[i].z_bounds = reachable = {lo <= -range_limit ? unbounded_lo : lo,
+                                                  hi > range_limit ? unbounded_hi : hi - 1};
+            }
+        }
+
+        [[nodiscard]] bool stack_solvable() const {
+            long depth = 0;
+            for (const block& b : blocks) {
+                if (!b.check)
+                    return false;
+                const digit_check& d = *b.check;
+                bool push = d.div == 1 && d.b > digit_max;
+                bool pop = d.div == d.mod;
+                if (d.mod != d.mul || !(push || pop) || d.c < 0 || d.c + digit_max >= d.mod)
+                    return false;
+                if ((depth += push ? 1 : -1) < 0)
+                    return false;
+            }
+            return depth == 0;
+        }
+
+        template <bool Min>
+        bool search_from(size_t i, registers r, std::vector<long>& digits,
+                         std::vector<std::unordered_set<registers, registers_hash>>& failed) const {
+            if (i == blocks.size())
+                return r[Z] == 0;
+            const block& b = blocks[i];
+            r = b.normalize(r);
+            if (!b.admits(r) || failed[i].contains(r))
+                return false;
+            for (long k = 0; k <= digit_max - digit_min; ++k) {
+                digits[i] = Min ? digit_min + k : digit_max - k;
+                if (search_from<Min>(i + 1, b.run(r, digits[i]), digits, failed))
+                    return true;
+            }
+            failed[i].insert(r);
+            return false;
+        }
+
+        template <bool Min>
+        std::optional<std::vector<long>> search_subtree(long first_digit) const {
+            std::vector<std::unordered_set<registers, registers_hash>> failed(blocks.size());
+            std::vector<long> digits(blocks.size());
+            registers start = blocks[0].normalize({});
+            if (!blocks[0].admits(start))
+                return {};
+            digits[0] = first_digit;
+            if (!search_from<Min>(1, blocks[0].run(start, first_digit), digits, failed))
+                return {};
+            return digits;
+        }
+
+        // Works for any program: every choice of first digit is searched on its own thread
+        // with a memo of the (block, live registers) states known to fail. Returns the best
+        // input found under each first digit, best first.
+        template <bool Min>
+        std::vector<std::vector<long>> search() const {
+            if (blocks.empty())
+                return {};
+            std::array<std::optional<std::vector<long>>, digit_max - digit_min + 1> results;
+            std::vector<std::thread> workers;
+            for (long d = digit_min; d <= digit_max; ++d) {
+                workers.emplace_back([this, d, &results] { results[d - digit_min] = search_subtree<Min>(d); });
+            }
+            for (auto& worker : workers) {
+                worker.join();
+            }
+            std::vector<std::vector<long>> to_return;
+            for (size_t k = 0; k < results.size(); ++k) {
+                if (auto& result = results[Min ? k : results.size() - 1 - k])
+                    to_return.push_back(std::move(*result));
+            }
+            return to_return;
+        }
+    };
+
     /* ================================================
      * FILE PARSING
      * ===============================================
@@ -559,6 +554,7 @@ namespace aoc2021::day24 {
         if (sscanf(s.c_str(), "inp %c", &c1)) {
             inst.op = INP;
             inst.dest = static_cast<variable>(c1 - 'w');
+            inst.literal = false;
             return in;
         }
         if (sscanf(s.c_str(), "%s %c %d", inst_name, &c1, &i) == 3) {
@@ -581,70 +577,68 @@ namespace aoc2021::day24 {
      * TESTING
      * ===============================================
      */
+    long to_number(const std::vector<long>& answer) {
+        return std::accumulate(answer.begin(), answer.end(), 0l, [](long acc, long digit) { return acc * 10 + digit; });
+    }
+
     void print_answer(const std::vector<long>& answer) {
-        for (int i = 0; i < 14; i++) {
-            myprintf("%ld", answer[i]);
+        for (long digit : answer) {
+            myprintf("%ld", digit);
         }
         myprintf("\n");
     }
 
-    void test_answer(const std::vector<long>& answer) {
-        myprintf("Testing: ");
-        print_answer(answer);
-
-        auto simulate1 = simulate(instructions, answer)[3];
-        myprintf("simulate bytecode: %ld\n", simulate1);
-
-        auto simulate2 = simulate(answer)[3];
-        assert(simulate2 == simulate1);
-        myprintf("simulate c translation: %ld\n", simulate2);
-
-        auto Aitr = As.begin();
-        auto Bitr = Bs.begin();
-        auto Citr = Cs.begin();
-        long isolated_0 = std::accumulate(answer.begin(), answer.end(), 0l, [&](long old_z, long input) {
-            return new_z0(*Aitr++, *Bitr++, *Citr++, input, old_z);
-        });
-        assert(isolated_0 == simulate1);
-        myprintf("new_z0: %ld\n", isolated_0);
-
-        Aitr = As.begin();
-        Bitr = Bs.begin();
-        Citr = Cs.begin();
-        long isolated_1 = std::accumulate(answer.begin(), answer.end(), 0l, [&](long old_z, long input) {
-            return new_raw(*Aitr++, *Bitr++, *Citr++, input, old_z);
-        });
-        assert(isolated_1 == simulate1);
-        myprintf("new_raw: %ld\n", isolated_1);
-    }
-
-    void init(puzzle_options filename) {
+    const monad& get_monad(puzzle_options filename) {
+        static std::optional<monad> m;
+        if (m)
+            return *m;
         auto instruction_range = get_stream<instruction>(filename);
-        instructions = std::vector(instruction_range.begin(), instruction_range.end());
+        return m.emplace(std::vector(instruction_range.begin(), instruction_range.end()));
+    }
 
-        auto split = split_code(instructions);
-        auto As_range = split | stdv::transform([](auto instructions) { return instructions[4].source_lit == 1; });
-        auto Bs_range = split | stdv::transform([](auto instructions) { return instructions[5].source_lit; });
-        auto Cs_range = split | stdv::transform([](auto instructions) { return instructions[15].source_lit; });
+    // The candidates come from the specialized blocks, so they are checked against the
+    // original byte code, the search results all in one batch, before the best valid one is taken
+    template <bool Min>
+    std::optional<std::vector<long>> solve(const monad& m) {
+        if (m.stack_solvable()) {
+            std::vector<char> As;
+            std::vector<int> Bs, Cs;
+            for (const block& b : m.blocks) {
+                As.push_back(b.check->div == 1);
+                Bs.push_back(static_cast<int>(b.check->b));
+                Cs.push_back(static_cast<int>(b.check->c));
+            }
+            auto answer = get_valid_input<Min>(As, Bs, Cs);
+            if (answer && verify_inputs(m.instructions, {*answer})[0])
+                return answer;
+        }
 
-        As = std::vector<char>(As_range.begin(), As_range.end());
-        Bs = std::vector<int>(Bs_range.begin(), Bs_range.end());
-        Cs = std::vector<int>(Cs_range.begin(), Cs_range.end());
+        auto candidates = m.search<Min>();
+        auto valid = verify_inputs(m.instructions, candidates);
+        for (size_t i = 0; i < candidates.size(); ++i) {
+            if (valid[i])
+                return candidates[i];
+        }
+        return {};
     }
+
     answertype puzzle1(puzzle_options filename) {
-        init(filename);
-        auto answer = get_valid_input<false>(As, Bs, Cs);
-        print_answer(answer);
-        return {};
+        auto answer = solve<false>(get_monad(filename));
+        if (!answer)
+            return {};
+        print_answer(*answer);
+        return to_number(*answer);
     }
 
-    answertype puzzle2([[maybe_unused]] puzzle_options filename) {
-        auto answer = get_valid_input<true>(As, Bs, Cs);
-        print_answer(answer);
-        return {};
+    answertype puzzle2(puzzle_options filename) {
+        auto answer = solve<true>(get_monad(filename));
+        if (!answer)
+            return {};
+        print_answer(*answer);
+        return to_number(*answer);
     }
 
 #undef CALL_NEXT
 #undef GET_SOURCE
 #undef PARSE_REG
-} // namespace aoc2021::day24
\ No newline at end of file
+} // namespace aoc2021::day24
@@ -1,115 +1,137 @@
 #include "../../../common.h"
-#include "ox/grid.h"
-#include <chrono>
-#include <thread>
+#include <bit>
 
 #define DAY  25
 
 namespace aoc2021::day25 {
-    enum class space : char { EMPTY, SOUTH_FACING, RIGHT_FACING, ERROR };
+    using word = uint64_t;
+    constexpr size_t word_bits = 64;
 
-    class sea_floor : public ox::grid<space> {
-        using ox::grid<space>::grid;
+    // Each herd is a bit-plane of width x height bits, one row after another and each row padded to whole words.
+    // A herd step is then a handful of word operations per row: a cucumber moves when the cell it faces is clear
+    // of both herds, and the fixed point is reached when no word of either herd had anything movable.
+    class sea_floor {
+        std::vector<word> east;
+        std::vector<word> south;
+        std::vector<word> scratch;
+        std::vector<word> occupied;
+        std::vector<word> movable;
+        std::vector<word> arrived;
+        size_t width = 0;
+        size_t height = 0;
+        size_t words = 0;
 
-        void move_right_row(const std::pair<raw_iterator, raw_iterator>& row) {
-            const auto& [start, end] = row;
-            bool start_empty = *start == space::EMPTY;
+        [[nodiscard]] word last_word_mask() const {
+            size_t used = width % word_bits;
+            return used == 0 ? ~word(0) : (word(1) << used) - 1;
+        }
 
-            // Determine which cucumbers can move
-            for (auto temp_start = start; temp_start != end; ++temp_start) {
-                if (*temp_start != space::RIGHT_FACING)
-                    continue;
-                if (auto move_location = right(std::optional(temp_start)); move_location) {
-                    if (**move_location == space::EMPTY) {
-                        std::swap(*temp_start, **move_location);
-                        ++temp_start;
-                    }
-                } else {
-                    if (start_empty)
-                        std::swap(*temp_start, *start);
-                }
-            }
+        // out bit x = row bit (x + 1) % width
+        void next_cells(const word* row, word* out) const {
+            for (size_t w = 0; w < words; ++w)
+                out[w] = (row[w] >> 1) | (w + 1 < words ? row[w + 1] << 63 : 0);
+            out[(width - 1) / word_bits] |= (row[0] & 1) << ((width - 1) % word_bits);
         }
 
-        void move_south_column(int column_id) {
-            const auto start = data.begin() + column_id;
-            bool start_empty = *start == space::EMPTY;
+        // out bit x = row bit (x - 1) % width
+        void previous_cells(const word* row, word* out) const {
+            for (size_t w = words; w-- > 0;)
+                out[w] = (row[w] << 1) | (w > 0 ? row[w - 1] >> 63 : 0);
+            out[0] |= (row[(width - 1) / word_bits] >> ((width - 1) % word_bits)) & 1;
+            out[words - 1] &= last_word_mask();
+        }
 
-            // Determine which cucumbers can move
-            for (auto temp_start = start; temp_start < data.end(); temp_start += get_width()) {
-                if (*temp_start != space::SOUTH_FACING)
-                    continue;
-                if (auto move_location = down(std::optional(temp_start)); move_location) {
-                    if (**move_location == space::EMPTY) {
-                        std::swap(*temp_start, **move_location);
-                        temp_start += get_width();
-                    }
-                } else {
-                    if (start_empty)
-                        std::swap(*temp_start, *start);
+        bool move_east() {
+            word moved = 0;
+            for (size_t y = 0; y < height; ++y) {
+                word* herd = &east[y * words];
+                const word* other = &south[y * words];
+                for (size_t w = 0; w < words; ++w)
+                    occupied[w] = herd[w] | other[w];
+                next_cells(occupied.data(), movable.data());
+                for (size_t w = 0; w < words; ++w) {
+                    movable[w] = herd[w] & ~movable[w];
+                    moved |= movable[w];
                 }
+                previous_cells(movable.data(), arrived.data());
+                for (size_t w = 0; w < words; ++w)
+                    herd[w] = (herd[w] & ~movable[w]) | arrived[w];
             }
+            return moved != 0;
         }
 
-        void move_right() {
-            for (std::pair<raw_iterator, raw_iterator> row : *this) {
-                move_right_row(row);
+        bool move_south() {
+            word moved = 0;
+            for (size_t y = 0; y < height; ++y) {
+                size_t below = (y + 1 == height ? 0 : y + 1) * words;
+                for (size_t w = 0; w < words; ++w) {
+                    word movable = south[y * words + w] & ~(east[below + w] | south[below + w]);
+                    scratch[y * words + w] = movable;
+                    moved |= movable;
+                }
             }
+            for (size_t y = 0; y < height; ++y) {
+                size_t below = (y + 1 == height ? 0 : y + 1) * words;
+                for (size_t w = 0; w < words; ++w) {
+                    south[y * words + w] &= ~scratch[y * words + w];
+                    south[below + w] |= scratch[y * words + w];
+                }
+            }
+            return moved != 0;
         }
 
-        void move_south() {
-            for (int i : stdv::iota(0ul, get_width())) {
-                move_south_column(i);
+    public:
+        explicit sea_floor(const std::vector<std::string>& rows)
+            : width(rows.front().size()), height(rows.size()), words((width + word_bits - 1) / word_bits) {
+            east.assign(words * height, 0);
+            south.assign(words * height, 0);
+            scratch.assign(words * height, 0);
+            occupied.assign(words, 0);
+            movable.assign(words, 0);
+            arrived.assign(words, 0);
+            for (size_t y = 0; y < height; ++y) {
+                for (size_t x = 0; x < width; ++x) {
+                    word bit = word(1) << (x % word_bits);
+                    if (rows[y][x] == '>')
+                        east[y * words + x / word_bits] |= bit;
+                    else if (rows[y][x] == 'v')
+                        south[y * words + x / word_bits] |= bit;
+                }
             }
         }
-    public:
-        void move() {
-            move_right();
-            move_south();
+
+        // Returns false once neither herd can move any more
+        bool move() {
+            bool east_moved = move_east();
+            bool south_moved = move_south();
+            return east_moved || south_moved;
         }
 
-        void print_array() {
-            leveled_foreach(
-                    [](auto& elem) {
-                        myprintf("%c",
-                               elem == space::EMPTY          ? '.'
-                               : elem == space::RIGHT_FACING ? '>'
-                               : elem == space::SOUTH_FACING ? 'v'
-                                                             : 'X');
-                    },
-                    []() { myprintf("\n"); });
+        void print_array() const {
+            for (size_t y = 0; y < height; ++y) {
+                for (size_t x = 0; x < width; ++x) {
+                    size_t w = y * words + x / word_bits;
+                    word bit = word(1) << (x % word_bits);
+                    myprintf("%c", east[w] & bit ? '>' : south[w] & bit ? 'v' : '.');
+                }
+                myprintf("\n");
+            }
             myprintf("\n");
         }
     };
 
     answertype puzzle1(puzzle_options filename) {
-        using namespace std::chrono_literals;
-        sea_floor cucumbers(get_stream<ox::line>(filename), [](char a) {
-            switch (a) {
-                case '.': return space::EMPTY;
-                case '>': return space::RIGHT_FACING;
-                case 'v': return space::SOUTH_FACING;
-                default: return space::ERROR;
-            }
-        });
+        auto input = get_stream<ox::line>(filename);
+        sea_floor cucumbers(std::vector<std::string>(input.begin(), input.end()));
 
-        cucumbers.print_array();
-
-        auto prev = cucumbers;
         int i = 1;
-        for (;; ++i) {
-            myprintf("\033[2J\033[1;1H");
-            cucumbers.print_array();
-            cucumbers.move();
-            if (prev == cucumbers)
-                break;
-            prev = cucumbers;
-            //std::this_thread::sleep_for(60ms);
-        }
+        while (cucumbers.move())
+            ++i;
 
+        cucumbers.print_array();
         myprintf("Stops moving after %d step\n", i);
         return i;
     }
 
     answertype puzzle2([[maybe_unused]] puzzle_options filename) { return {}; }
-} // namespace aoc2021::day25
\ No newline at end of file
+} // namespace aoc2021::day25
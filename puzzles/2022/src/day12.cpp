@@ -1,63 +1,55 @@
 #include "../../../common.h"
+#include "../../../grid_search.h"
 #include <ox/grid.h>
-#include <ox/graph.h>
 #include <ranges>
 
 namespace aoc2022::day12 {
     struct heightmap : public ox::grid<char> {
-        using position = raw_iterator;
-        position start;
-        position end;
-        struct mock_end_sentinel {
-            friend bool operator==(const position& r, const mock_end_sentinel&) { return *r == 'a'; }
-        };
+        size_t start;
+        size_t end;
 
         template <typename R>
         explicit heightmap(R&& r) : ox::grid<char>{std::forward<R>(r)} {
-            start = stdr::find(data, 'S');
-            end = stdr::find(data, 'E');
-            *start = 'a';
-            *end = 'z';
+            start = stdr::find(data, 'S') - data.begin();
+            end = stdr::find(data, 'E') - data.begin();
+            data[start] = 'a';
+            data[end] = 'z';
         }
 
-        template <typename End, typename Filter>
-        auto find_path(position start, End end, Filter neighbour_filter) {
-            return ox::dikstra(
-                    start,
-                    end,
-                    [neighbour_filter, this](auto curr) -> std::vector<std::pair<position, int>> {
-                        auto neighbours = this->cardinal_neighbour_range(curr);
-                        auto n = neighbours | valid_index()
-                               | stdv::filter([&](const auto& x) { return neighbour_filter(curr, x); })
-                               | stdv::transform([](const auto& x) -> std::pair<position, int> {
-                                     return std::make_pair(x, 1);
-                                 });
-                        return std::vector(n.begin(), n.end());
-                    },
-                    [](...) { return 0; },
-                    ox::range_iterator_hash<decltype(data)>());
+        template <typename IsEnd, typename Filter>
+        long find_path(size_t from, IsEnd is_end, Filter can_step) {
+            auto length = dial_shortest_path(
+                    get_width(),
+                    get_height(),
+                    from,
+                    1,
+                    [&](size_t curr, size_t x) { return can_step(data[curr], data[x]) ? 1 : -1; },
+                    is_end);
+            return length.value_or(-1);
         }
 
-        auto find_path_part1() {
-            return find_path(start, end, [](position curr, position x) { return *x <= *curr + 1; });
+        long find_path_part1() {
+            return find_path(
+                    start, [this](size_t x) { return x == end; }, [](char curr, char x) { return x <= curr + 1; });
         }
 
-        auto find_path_part2() {
-            return find_path(end, mock_end_sentinel{}, [](position curr, position x) { return *x + 1 >= *curr; });
+        long find_path_part2() {
+            return find_path(
+                    end, [this](size_t x) { return data[x] == 'a'; }, [](char curr, char x) { return x + 1 >= curr; });
         }
     };
 
     answertype puzzle1(puzzle_options filename) {
         heightmap topology(get_stream<ox::line>(filename));
-        auto [path, length] = topology.find_path_part1();
-        myprintf("Path Length = %d\n", length);
+        auto length = topology.find_path_part1();
+        myprintf("Path Length = %ld\n", length);
         return length;
     }
 
     answertype puzzle2(puzzle_options filename) {
         heightmap topology(get_stream<ox::line>(filename));
-        auto [path, length] = topology.find_path_part2();
-        myprintf("Min Path Length = %d\n", length);
+        auto length = topology.find_path_part2();
+        myprintf("Min Path Length = %ld\n", length);
         return length;
     }
-} // namespace aoc2022::day12
\ No newline at end of file
+} // namespace aoc2022::day12
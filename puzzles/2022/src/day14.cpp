@@ -2,15 +2,13 @@
 #include <ox/grid.h>
 #include <variant>
 #include <vector>
-#include <stack>
 #include <ox/canvas.h>
-#include <ox/hash.h>
 
 namespace aoc2022::day14 {
     using namespace std::chrono_literals;
     using coord = std::pair<int, int>;
 
-    enum class occupied_by { rock, sand_still, sand_moving };
+    enum class occupied_by : char { empty, rock, sand_still, sand_moving };
     enum class operation { cont, still, end };
 
     constexpr coord start_position{500, 0};
@@ -30,87 +28,116 @@ namespace aoc2022::day14 {
         }
     } // namespace drawer
 
-    struct grid : public std::unordered_map<coord, occupied_by, ox::pair_hash<>> {
+    // Sand can never drift further than one column per row away from the source,
+    // so a dense [max_depth x (2 * max_depth + 1)] window around it covers every reachable cell.
+    struct cave {
+        int max_depth = 0;
+        int width = 0;
+        int x_offset = 0;
+        long sand_count = 0;
+        std::vector<occupied_by> cells;
+        std::vector<coord> path{start_position};
+
         template <stdr::range R>
         requires std::is_base_of_v<std::string, typename R::value_type>
-        explicit grid(R& r) : max_depth(0) {
+        explicit cave(R& r) {
+            std::vector<std::vector<coord>> rock_paths;
             for (const auto& s : r) {
-                add_line(s);
+                rock_paths.push_back(parse_line(s));
+            }
+            max_depth = stdr::max(rock_paths | stdv::join | stdv::transform(&coord::second)) + 2;
+            width = 2 * max_depth + 1;
+            x_offset = start_position.first - max_depth;
+            cells.assign(static_cast<size_t>(width) * static_cast<size_t>(max_depth), occupied_by::empty);
+            for (const auto& rock_path : rock_paths) {
+                add_path(rock_path);
             }
         }
 
-        void set_max() { max_depth = stdr::max(*this | stdv::keys | stdv::transform(&coord::second)) + 2; }
-
-        auto locked_insert(const value_type& val) {
-            return insert(val);
+        [[nodiscard]] bool in_bounds(int x, int y) const {
+            return y >= 0 && y < max_depth && x >= x_offset && x < x_offset + width;
         }
+        occupied_by& at(int x, int y) { return cells[static_cast<size_t>(y * width + x - x_offset)]; }
+        [[nodiscard]] occupied_by at(int x, int y) const { return cells[static_cast<size_t>(y * width + x - x_offset)]; }
+        [[nodiscard]] bool is_empty(int x, int y) const { return at(x, y) == occupied_by::empty; }
 
+        // Every grain follows the path of the previous one up to the point where that one came to rest,
+        // so instead of restarting from the source, the falling path is kept as a stack and resumed from its top.
         template <bool floor>
-        operation move_sand(coord& sand) {
-            if (sand.second + 1 >= max_depth) {
-                return floor ? operation::still : operation::end;
-            }
-
-            if (!contains(std::make_pair(sand.first, sand.second + 1))) {
-                sand.second++;
-                return operation::cont;
+        operation drop_sand() {
+            if (path.empty())
+                return operation::end;
+
+            while (true) {
+                auto [x, y] = path.back();
+                if (y + 1 >= max_depth) {
+                    if constexpr (floor)
+                        break;
+                    else
+                        return operation::end;
+                }
+                if (is_empty(x, y + 1)) {
+                    path.emplace_back(x, y + 1);
+                } else if (is_empty(x - 1, y + 1)) {
+                    path.emplace_back(x - 1, y + 1);
+                } else if (is_empty(x + 1, y + 1)) {
+                    path.emplace_back(x + 1, y + 1);
+                } else {
+                    break;
+                }
             }
 
-            if (!contains(std::make_pair(sand.first - 1, sand.second + 1))) {
-                sand.first--;
-                sand.second++;
-                return operation::cont;
-            }
+            auto [x, y] = path.back();
+            path.pop_back();
+            at(x, y) = occupied_by::sand_still;
+            ++sand_count;
+            if (drawer::drawing_window)
+                drawer::conditional_sleep(floor ? update_frequency2 : update_frequency);
+            return operation::still;
+        };
 
-            if (!contains(std::make_pair(sand.first + 1, sand.second + 1))) {
-                sand.first++;
-                sand.second++;
-                return operation::cont;
+        // With a floor, every non-rock cell with a filled cell among its three upper neighbours ends up filled,
+        // so the final amount of sand is a row by row flood fill without simulating any grain.
+        [[nodiscard]] long flood_fill_floor() const {
+            std::vector<char> row(static_cast<size_t>(width)), next(static_cast<size_t>(width));
+            row[static_cast<size_t>(start_position.first - x_offset)] = true;
+            long count = 1;
+            for (int y = 1; y < max_depth; ++y) {
+                const occupied_by* cell_row = cells.data() + static_cast<ptrdiff_t>(y) * width;
+                for (size_t i = 1; i + 1 < row.size(); ++i) {
+                    next[i] = (row[i - 1] | row[i] | row[i + 1]) && cell_row[i] != occupied_by::rock;
+                }
+                count += stdr::count(next, true);
+                std::swap(row, next);
             }
-
-            return operation::still;
+            return count;
         }
 
-        template <bool floor>
-        operation drop_sand() {
-            coord sand = start_position;
-            operation res;
-            std::vector<coord> path{sand};
-            while ((res = move_sand<floor>(sand)) == operation::cont) {}
-            if (res == operation::still) {
-                locked_insert(std::make_pair(sand, occupied_by::sand_still));
-                if (drawer::drawing_window)
-                    drawer::conditional_sleep(floor ? update_frequency2 : update_frequency);
-                if constexpr (floor)
-                    return sand == start_position ? operation::end : operation::still;
-                else
-                    return operation::still;
-            }
-            return operation::end;
-        };
     private:
-        int max_depth;
-        void add_line(const std::string& line) {
-            long x1, x2, y1, y2;
+        static std::vector<coord> parse_line(const std::string& line) {
+            std::vector<coord> points;
             const char* str_ptr = line.data();
 
-            x1 = strtol(str_ptr, const_cast<char**>(&str_ptr), 10);
-            y1 = strtol(++str_ptr, const_cast<char**>(&str_ptr), 10);
-            while (str_ptr < line.end().base()) {
-                x2 = strtol(str_ptr += 4, const_cast<char**>(&str_ptr), 10);
-                y2 = strtol(++str_ptr, const_cast<char**>(&str_ptr), 10);
-                for (long i = x1; i <= x2; i++) {
-                    for (long j = y1; j <= y2; j++) {
-                        locked_insert(std::make_pair(std::make_pair(i, j), occupied_by::rock));
-                    }
-                }
-                for (long i = x2; i <= x1; i++) {
-                    for (long j = y2; j <= y1; j++) {
-                        locked_insert(std::make_pair(std::make_pair(i, j), occupied_by::rock));
+            while (true) {
+                int x = static_cast<int>(strtol(str_ptr, const_cast<char**>(&str_ptr), 10));
+                int y = static_cast<int>(strtol(++str_ptr, const_cast<char**>(&str_ptr), 10));
+                points.emplace_back(x, y);
+                if (str_ptr >= line.end().base())
+                    return points;
+                str_ptr += 4;
+            }
+        }
+
+        void add_path(const std::vector<coord>& points) {
+            for (size_t p = 1; p < points.size(); ++p) {
+                auto [x1, x2] = std::minmax(points[p - 1].first, points[p].first);
+                auto [y1, y2] = std::minmax(points[p - 1].second, points[p].second);
+                for (int i = x1; i <= x2; i++) {
+                    for (int j = y1; j <= y2; j++) {
+                        if (in_bounds(i, j))
+                            at(i, j) = occupied_by::rock;
                     }
                 }
-                y1 = y2;
-                x1 = x2;
             }
         }
     };
@@ -126,7 +153,7 @@ namespace aoc2022::day14 {
             SDL_RenderFillRect(drawing_window->screen_renderer(), &r);
         }
 
-        bool draw_cave(const grid& pos) {
+        bool draw_cave(const cave& c) {
             {
                 if (not drawing_window) {
                     return false;
@@ -139,23 +166,23 @@ namespace aoc2022::day14 {
                     }
                 }
 
-                auto [minI, maxI] = stdr::minmax(pos | stdv::keys | stdv::transform(&coord::first));
-                auto [minJ, maxJ] = stdr::minmax(pos | stdv::keys | stdv::transform(&coord::second));
-
-                current_min_y = std::min(current_min_y, minJ - 5);
-                current_min_x = std::min(current_min_x, minI - 5);
-                current_max_y = std::max(current_max_y, maxJ + 5);
-                current_max_x = std::max(current_max_x, maxI + 5);
+                current_min_y = std::min(current_min_y, -5);
+                current_min_x = std::min(current_min_x, c.x_offset - 5);
+                current_max_y = std::max(current_max_y, c.max_depth + 5);
+                current_max_x = std::max(current_max_x, c.x_offset + c.width + 5);
 
                 drawing_window->set_window_size(std::make_pair(scale * (current_max_x - current_min_x + 1),
                                                                scale * (current_max_y - current_min_y + 1)));
 
                 drawing_window->clear_render();
-                for (const auto& [pos, type] : pos) {
-                    auto& [x, y] = pos;
-                    drawing_window->set_renderer_color(type == occupied_by::rock ? ox::named_colors::red1
-                                                                                 : ox::named_colors::blue1);
-                    draw_point(x, y);
+                for (int y = 0; y < c.max_depth; ++y) {
+                    for (int x = c.x_offset; x < c.x_offset + c.width; ++x) {
+                        if (c.is_empty(x, y))
+                            continue;
+                        drawing_window->set_renderer_color(c.at(x, y) == occupied_by::rock ? ox::named_colors::red1
+                                                                                           : ox::named_colors::blue1);
+                        draw_point(x, y);
+                    }
                 }
 
                 drawing_window->set_renderer_color(ox::named_colors::green1);
@@ -175,30 +202,33 @@ namespace aoc2022::day14 {
         }
     } // namespace drawer
 
-    grid& get_grid(puzzle_options filename) {
-        static std::optional<grid> g;
-        if (g)
-            return *g;
+    cave get_cave(puzzle_options filename) {
+        static std::optional<cave> c;
+        if (c)
+            return *c;
 
         auto input = get_stream<ox::line>(filename);
-        g.emplace(input);
-        g->set_max();
-        return *g;
+        c.emplace(input);
+        return *c;
     }
 
     template <bool floor>
-    auto solve(puzzle_options filename) {
-        grid& g = get_grid(filename);
-        size_t count = 0;
-        std::jthread a;
-        while (g.drop_sand<floor>() != operation::end) {
-            if (drawer::drawing_window && (!floor || (++count % 10 == 0)))
-                drawer::draw_cave(g);
+    long solve(puzzle_options filename) {
+        cave c = get_cave(filename);
+        long sand;
+        if (floor && !drawer::drawing_window) {
+            sand = c.flood_fill_floor();
+        } else {
+            size_t count = 0;
+            while (c.drop_sand<floor>() != operation::end) {
+                if (drawer::drawing_window && (!floor || (++count % 10 == 0)))
+                    drawer::draw_cave(c);
+            }
+            if (drawer::drawing_window)
+                drawer::draw_cave(c);
+            sand = c.sand_count;
         }
-        if (drawer::drawing_window)
-            drawer::draw_cave(g);
-        auto sand = stdr::count(g | stdv::values, occupied_by::sand_still);
-        myprintf("The amount of still sand before sand falls forever is %zu\n", sand);
+        myprintf("The amount of still sand before sand falls forever is %ld\n", sand);
         drawer::conditional_sleep(after_puzzle_wait);
         return sand;
     }
@@ -216,4 +246,4 @@ namespace aoc2022::day14 {
         drawer::drawing_window.reset();
         return result;
     }
-} // namespace aoc2022::day14
\ No newline at end of file
+} // namespace aoc2022::day14
@@ -0,0 +1,215 @@
+#ifndef ADVENTOFCODE_ALMANAC_H
+#define ADVENTOFCODE_ALMANAC_H
+
+#include "../../../common.h"
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <sstream>
+#include <unordered_set>
+
+namespace aoc2023::day05 {
+    using lset = std::unordered_set<long>;
+
+    struct seeds {
+        std::vector<long> data;
+    };
+
+    struct seeds2 {
+        std::vector<std::pair<long, long>> data;
+        bool in_range(long seed) {
+            return stdr::any_of(data, [seed](auto x) {
+                auto [start, len] = x;
+                long dist = seed - start;
+                return (dist >= 0 && dist < len);
+            });
+        }
+    };
+
+    struct int_map {
+        long dest_start;
+        long source_start;
+        long distance;
+
+        [[nodiscard]] bool in_range(long seed) const {
+            long dist = seed - source_start;
+            return (dist >= 0 && dist < distance);
+        }
+
+        [[nodiscard]] long convert(long seed) const {
+            long dist = seed - source_start;
+            return dest_start + dist;
+        }
+
+        [[nodiscard]] bool in_range_rev(long location) const {
+            long dist = location - dest_start;
+            return (dist >= 0 && dist < distance);
+        }
+
+        [[nodiscard]] long convert_rev(long location) const {
+            long dist = location - dest_start;
+            return source_start + dist;
+        }
+    };
+
+    struct int_maps {
+        std::vector<int_map> maps;
+
+        [[nodiscard]] long convert(long seed) const {
+            for (auto& map : maps) {
+                if (map.in_range(seed))
+                    return map.convert(seed);
+            }
+            return seed;
+        }
+
+        void convert_rev(lset& vec) const {
+            for (auto& map : maps) {
+                vec.insert(map.dest_start);
+            }
+            std::vector<long> marks(vec.begin(), vec.end());
+            for (long mark : marks) {
+                bool can_map_to_self = true;
+                for (auto& map : maps) {
+                    if (map.in_range_rev(mark))
+                        vec.insert(map.convert_rev(mark));
+                    if (map.in_range(mark))
+                        can_map_to_self = false;
+                }
+                if (!can_map_to_self) {
+                    vec.erase(mark);
+                }
+            }
+        }
+    };
+
+    struct pipeline {
+        std::vector<int_maps> pipe;
+        [[nodiscard]] long run_trough_pipeline(long seed) const {
+            for (auto& map : pipe) {
+                seed = map.convert(seed);
+            }
+            return seed;
+        }
+        [[nodiscard]] lset run_trough_pipeline_rev() const {
+            lset vec{};
+            for (auto& map : stdv::reverse(pipe)) {
+                map.convert_rev(vec);
+            }
+            return vec;
+        }
+    };
+
+    inline STREAM_IN(seeds, s) {
+        s.data.clear();
+        std::string line;
+        std::getline(in, line);
+        std::string header;
+        std::stringstream ss(line);
+        ss >> header;
+        long l;
+        while (ss >> l) {
+            s.data.push_back(l);
+        }
+        return in;
+    }
+    inline STREAM_IN(seeds2, s) {
+        s.data.clear();
+        std::string line;
+        std::getline(in, line);
+        std::string header;
+        std::stringstream ss(line);
+        ss >> header;
+        long start, length;
+        while (ss >> start >> length) {
+            s.data.emplace_back(start, length);
+        }
+        return in;
+    }
+    inline STREAM_IN(int_map, s) {
+        return in >> s.dest_start >> s.source_start >> s.distance;
+    }
+    inline STREAM_IN(int_maps, s) {
+        s.maps.clear();
+        std::string line;
+        while (std::getline(in, line)) {
+            if (line.empty())
+                return in;
+            std::stringstream ss(line);
+            s.maps.emplace_back();
+            ss >> s.maps.back();
+        }
+        return in;
+    }
+    inline STREAM_IN(pipeline, s) {
+        s.pipe.clear();
+        std::string line;
+        while (std::getline(in, line)) {
+            if (line.empty())
+                if (s.pipe.empty() || s.pipe.back().maps.empty())
+                    continue;
+            s.pipe.emplace_back();
+            in >> s.pipe.back();
+        }
+        return in;
+    }
+
+    // One piece of a seed range carried through one stage of the pipeline. `map` is the index of the int_map that
+    // moved it, or -1 where no map applies and the values pass through unchanged.
+    struct range_step {
+        uint32_t stage;
+        int32_t map;
+        int64_t source_start;
+        int64_t dest_start;
+        int64_t length;
+
+        bool operator==(const range_step&) const = default;
+    };
+
+    using seed_range = std::pair<long, long>;
+
+    // Splits every range at the map boundaries of one stage and maps the pieces, reporting each piece to on_step
+    template <typename OnStep>
+    std::vector<seed_range> convert_ranges(const int_maps& stage, uint32_t stage_index,
+                                           const std::vector<seed_range>& ranges, OnStep&& on_step) {
+        std::vector<int32_t> order(stage.maps.size());
+        std::iota(order.begin(), order.end(), 0);
+        stdr::sort(order, {}, [&stage](int32_t i) { return stage.maps[size_t(i)].source_start; });
+
+        std::vector<seed_range> to_return;
+        auto emit = [&](int32_t map, long source, long dest, long length) {
+            on_step(range_step{stage_index, map, source, dest, length});
+            to_return.emplace_back(dest, length);
+        };
+        for (auto [start, length] : ranges) {
+            long cursor = start;
+            long end = start + length;
+            for (int32_t i : order) {
+                const int_map& m = stage.maps[size_t(i)];
+                if (m.source_start + m.distance <= cursor)
+                    continue;
+                if (m.source_start >= end)
+                    break;
+                if (m.source_start > cursor)
+                    emit(-1, cursor, cursor, m.source_start - cursor);
+                long piece_start = std::max(cursor, m.source_start);
+                long piece_end = std::min(end, m.source_start + m.distance);
+                emit(i, piece_start, m.convert(piece_start), piece_end - piece_start);
+                cursor = piece_end;
+            }
+            if (cursor < end)
+                emit(-1, cursor, cursor, end - cursor);
+        }
+        return to_return;
+    }
+
+    template <typename OnStep>
+    std::vector<seed_range> run_ranges_through_pipeline(const pipeline& p, std::vector<seed_range> ranges,
+                                                        OnStep&& on_step) {
+        for (uint32_t stage = 0; stage < p.pipe.size(); ++stage)
+            ranges = convert_ranges(p.pipe[stage], stage, ranges, on_step);
+        return ranges;
+    }
+} // namespace aoc2023::day05
+
+#endif // ADVENTOFCODE_ALMANAC_H
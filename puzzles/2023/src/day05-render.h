@@ -0,0 +1,99 @@
+#ifndef ADVENTOFCODE_DAY05_RENDER_H
+#define ADVENTOFCODE_DAY05_RENDER_H
+
+#include "day05-trace.h"
+#include <ox/canvas.h>
+
+namespace aoc2023::day05 {
+#define handleEvents \
+    while (SDL_PollEvent(&e)) { \
+        switch (e.type) { \
+            case SDL_QUIT: return; \
+        } \
+    }
+
+    inline long largest_value(const trace& t) {
+        long max = 1;
+        for (auto [start, length] : t.seeds)
+            max = std::max(max, start + length);
+        for (const auto& x : t.stages.pipe) {
+            for (auto [dest, start, size] : x.maps)
+                max = std::max({max, dest + size, start + size});
+        }
+        return max;
+    }
+
+    // Draws the seed ranges on the top row, then for every stage its maps (source boxes, the lines to where they
+    // move and the destination boxes) followed by the pieces of the seed ranges the stage produced
+    inline void render(const trace& t) {
+        auto bg = ox::named_colors::white;
+        auto box = ox::named_colors::cyan1;
+        auto outline = ox::named_colors::black;
+
+        int perline_scale = 3;
+        int box_witdh = 2;
+
+        double scalex = 1920.0 / double(largest_value(t));
+        int scaley = 1080 / int(t.stages.pipe.size() * size_t(perline_scale) + 1);
+        ox::sdl_instance window("Temp", true);
+        SDL_Event e;
+        window.background_color = bg;
+        window.clear_render();
+        window.redraw();
+
+        auto draw_box = [&](long start, long size, int y, ox::color fill) {
+            SDL_Rect r{int(double(start) * scalex), y, std::max(int(double(size) * scalex), 2 * box_witdh), scaley};
+            window.set_renderer_color(outline);
+            SDL_RenderFillRect(window.screen_renderer(), &r);
+            SDL_Rect r2{r.x + box_witdh, r.y + box_witdh, r.w - (2 * box_witdh), r.h - (2 * box_witdh)};
+            window.set_renderer_color(fill);
+            SDL_RenderFillRect(window.screen_renderer(), &r2);
+            window.redraw();
+        };
+
+        for (auto [seed, count] : t.seeds) {
+            draw_box(seed, count, 0, box);
+            handleEvents
+        }
+        ox::color temp[]{ox::named_colors::cyan1,
+                         ox::named_colors::SeaGreen1,
+                         ox::named_colors::LightCoral,
+                         ox::named_colors::LemonChiffon2};
+
+        auto step = t.steps.begin();
+        for (int i = 1; i <= int(t.stages.pipe.size()); i++) {
+            int source_y = perline_scale * i * scaley - (perline_scale - 1) * scaley;
+            int dest_y = perline_scale * i * scaley;
+            const auto& maps = t.stages.pipe[size_t(i - 1)].maps;
+            for (size_t j = 0; j < maps.size(); ++j) {
+                auto [dstart, sstart, size] = maps[j];
+                window.set_renderer_color(temp[j % 4]);
+                SDL_RenderDrawLine(window.screen_renderer(),
+                                   int(double(sstart) * scalex),
+                                   source_y + scaley,
+                                   int(double(dstart) * scalex),
+                                   dest_y);
+                SDL_RenderDrawLine(window.screen_renderer(),
+                                   int(double(sstart + size) * scalex),
+                                   source_y + scaley,
+                                   int(double(dstart + size) * scalex),
+                                   dest_y);
+                window.redraw();
+                draw_box(sstart, size, source_y, temp[j % 4]);
+                handleEvents
+            }
+            for (; step != t.steps.end() && step->stage == uint32_t(i - 1); ++step) {
+                draw_box(step->dest_start, step->length, dest_y, step->map < 0 ? box : temp[step->map % 4]);
+                handleEvents
+            }
+        }
+        window.redraw();
+        while (true) {
+            handleEvents
+        }
+    }
+
+#undef handleEvents
+} // namespace aoc2023::day05
+
+#endif // ADVENTOFCODE_DAY05_RENDER_H
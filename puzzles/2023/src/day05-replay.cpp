@@ -0,0 +1,70 @@
+#include "day05-render.h"
+#include <chrono>
+#include <cstring>
+
+long year = 2023, day = 5;
+bool do_print = true;
+
+// Replays a trace written by day05-visualizer without needing the puzzle input: every stage is run again on the
+// pieces the previous stage produced, timed, and checked against the recorded steps.
+//   day05-replay <trace> [--render] [--repeat N]
+int main(int argc, const char** argv) {
+    using namespace aoc2023::day05;
+    const char* path = nullptr;
+    bool do_render = false;
+    long repeat = 1;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--render"))
+            do_render = true;
+        else if (!strcmp(argv[i], "--repeat") && i + 1 < argc)
+            repeat = std::max(1l, strtol(argv[++i], nullptr, 10));
+        else
+            path = argv[i];
+    }
+    if (!path) {
+        printf("ERROR: No trace given\n");
+        return 1;
+    }
+    auto t = read_trace(path);
+    if (!t) {
+        printf("ERROR: %s is not a day05 trace\n", path);
+        return 1;
+    }
+
+    std::vector<range_step> replayed;
+    replayed.reserve(t->steps.size());
+    std::vector<seed_range> ranges = t->seeds;
+    for (uint32_t stage = 0; stage < t->stages.pipe.size(); ++stage) {
+        std::vector<seed_range> next;
+        auto start = std::chrono::steady_clock::now();
+        for (long r = 0; r < repeat; ++r)
+            next = convert_ranges(t->stages.pipe[stage], stage, ranges, [](const range_step&) {});
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+        size_t before = replayed.size();
+        convert_ranges(t->stages.pipe[stage], stage, ranges, [&replayed](const range_step& step) {
+            replayed.push_back(step);
+        });
+        myprintf("Stage %u: %3zu maps, %5zu ranges -> %5zu pieces in %.3f ms\n",
+                 stage,
+                 t->stages.pipe[stage].maps.size(),
+                 ranges.size(),
+                 replayed.size() - before,
+                 elapsed.count() / double(repeat));
+        ranges = std::move(next);
+    }
+
+    if (replayed != t->steps) {
+        printf("ERROR: Replay diverged from the %zu recorded steps\n", t->steps.size());
+        return 1;
+    }
+    if (ranges.empty()) {
+        printf("ERROR: No seeds made it through the pipeline\n");
+        return 1;
+    }
+    myprintf("%ld\n", stdr::min(ranges | stdv::keys));
+
+    if (do_render)
+        render(*t);
+    return 0;
+}
@@ -0,0 +1,113 @@
+#ifndef ADVENTOFCODE_DAY05_TRACE_H
+#define ADVENTOFCODE_DAY05_TRACE_H
+
+#include "almanac.h"
+#include <cstdio>
+#include <memory>
+
+namespace aoc2023::day05 {
+    // Everything the range pipeline did for one input: the seed ranges, the maps of every stage and every piece
+    // produced while carrying the seeds through them, in order.
+    //
+    // On disk it is a header followed by fixed-width records in host byte order:
+    //   "A5TR", uint32 version, uint32 stage count, uint32 seed count (at least one)
+    //   seed count x { int64 start, int64 length }
+    //   per stage: uint32 map count, then map count x { int64 dest start, int64 source start, int64 length }
+    //   uint64 step count, then step count x range_step (32 bytes)
+    struct trace {
+        std::vector<seed_range> seeds;
+        pipeline stages;
+        std::vector<range_step> steps;
+    };
+
+    constexpr char TRACE_MAGIC[4] = {'A', '5', 'T', 'R'};
+    constexpr uint32_t TRACE_VERSION = 1;
+    static_assert(sizeof(range_step) == 32 && std::has_unique_object_representations_v<range_step>);
+
+    using unique_file = std::unique_ptr<FILE, decltype([](FILE* f) { fclose(f); })>;
+
+    inline trace record_trace(const seeds2& s, const pipeline& p) {
+        trace to_return{s.data, p, {}};
+        run_ranges_through_pipeline(p, s.data, [&to_return](const range_step& step) {
+            to_return.steps.push_back(step);
+        });
+        return to_return;
+    }
+
+    inline bool write_trace(const trace& t, const char* path) {
+        unique_file f{fopen(path, "wb")};
+        if (!f)
+            return false;
+        auto put = [file = f.get()](const auto& value) { fwrite(&value, sizeof(value), 1, file); };
+        fwrite(TRACE_MAGIC, 1, sizeof(TRACE_MAGIC), f.get());
+        put(TRACE_VERSION);
+        put(uint32_t(t.stages.pipe.size()));
+        put(uint32_t(t.seeds.size()));
+        for (auto [start, length] : t.seeds) {
+            put(int64_t(start));
+            put(int64_t(length));
+        }
+        for (const int_maps& stage : t.stages.pipe) {
+            put(uint32_t(stage.maps.size()));
+            for (const int_map& m : stage.maps) {
+                put(int64_t(m.dest_start));
+                put(int64_t(m.source_start));
+                put(int64_t(m.distance));
+            }
+        }
+        put(uint64_t(t.steps.size()));
+        fwrite(t.steps.data(), sizeof(range_step), t.steps.size(), f.get());
+        return !ferror(f.get());
+    }
+
+    inline std::optional<trace> read_trace(const char* path) {
+        unique_file f{fopen(path, "rb")};
+        if (!f)
+            return std::nullopt;
+        bool ok = fseek(f.get(), 0, SEEK_END) == 0;
+        long file_size = ftell(f.get());
+        ok = ok && file_size >= 0 && fseek(f.get(), 0, SEEK_SET) == 0;
+        auto get = [file = f.get(), &ok]<typename T>(T value) {
+            ok = ok && fread(&value, sizeof(value), 1, file) == 1;
+            return value;
+        };
+        // A count is only trusted if that many records of the given size are left in the file, so a corrupt count
+        // fails the read instead of allocating for it
+        auto fits = [file = f.get(), file_size, &ok](uint64_t count, size_t record_size) -> size_t {
+            ok = ok && count <= uint64_t(file_size - ftell(file)) / record_size;
+            return ok ? size_t(count) : 0;
+        };
+
+        char magic[4] = {};
+        ok = fread(magic, 1, sizeof(magic), f.get()) == sizeof(magic) && std::equal(magic, magic + 4, TRACE_MAGIC);
+        if (!ok || get(uint32_t()) != TRACE_VERSION)
+            return std::nullopt;
+
+        trace to_return;
+        uint32_t stage_count = get(uint32_t());
+        uint32_t seed_count = get(uint32_t());
+        ok = ok && seed_count > 0;
+        to_return.stages.pipe.resize(fits(stage_count, sizeof(uint32_t)));
+        to_return.seeds.resize(fits(seed_count, 2 * sizeof(int64_t)));
+        for (auto& [start, length] : to_return.seeds) {
+            start = get(int64_t());
+            length = get(int64_t());
+        }
+        for (int_maps& stage : to_return.stages.pipe) {
+            stage.maps.resize(fits(get(uint32_t()), 3 * sizeof(int64_t)));
+            for (int_map& m : stage.maps) {
+                m.dest_start = get(int64_t());
+                m.source_start = get(int64_t());
+                m.distance = get(int64_t());
+            }
+        }
+        to_return.steps.resize(fits(get(uint64_t()), sizeof(range_step)));
+        ok = ok && fread(to_return.steps.data(), sizeof(range_step), to_return.steps.size(), f.get())
+                           == to_return.steps.size();
+        if (!ok)
+            return std::nullopt;
+        return to_return;
+    }
+} // namespace aoc2023::day05
+
+#endif // ADVENTOFCODE_DAY05_TRACE_H
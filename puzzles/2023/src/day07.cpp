@@ -1,8 +1,8 @@
 #include "../../../common.h"
 #include <algorithm>
-#include <unordered_map>
-#include <tuple>
+#include <array>
 #include <numeric>
+#include <utility>
 
 namespace aoc2023::day07 {
     enum HAND_TYPES { DEFAULT, HIGH_CARD, ONE_PAIR, TWO_PAIR, THREE_KIND, FULL_HOUSE, FOUR_KIND, FIVE_KIND };
@@ -13,67 +13,51 @@ namespace aoc2023::day07 {
 #define HAND_SIZE 5
 
     using card = long;
-    struct hand : public std::array<card, HAND_SIZE> {
-        using std::array<card, HAND_SIZE>::array;
-        HAND_TYPES type = DEFAULT;
-
-        static HAND_TYPES determine_type(std::array<int, MAX> counts) {
-            int has[4] = {};
-            for (auto count : counts) {
-                if (count >= 2)
-                    ++has[count - 2];
-            }
-            if (has[3])
-                return FIVE_KIND;
-            if (has[2])
-                return FOUR_KIND;
-            if (has[1] && has[0])
-                return FULL_HOUSE;
-            if (has[1])
-                return THREE_KIND;
-            if (has[0] == 2)
-                return TWO_PAIR;
-            if (has[0] == 1)
-                return ONE_PAIR;
-            return HIGH_CARD;
-        }
-
-        HAND_TYPES get_type_recursive_imp(std::array<int, MAX> curr_count = {}, int curr_index = 0) const {
-            if (curr_index >= HAND_SIZE) {
-                return determine_type(curr_count);
-            }
-
-            card c = (*this)[curr_index];
-            if (c != JOKER) {
-                ++curr_count[c];
-                return get_type_recursive_imp(curr_count, curr_index + 1);
-            }
-
-            HAND_TYPES max = DEFAULT;
-            for (card c = 0; c < MAX; ++c) {
-                ++curr_count[c];
-                max = std::max(max, get_type_recursive_imp(curr_count, curr_index + 1));
-                --curr_count[c];
-            }
-            return max;
+    using hand = std::array<card, HAND_SIZE>;
+
+    // Type in bits 20-23 and the five cards as nibbles below it, so comparing keys compares hands. Jokers always
+    // do best by copying the most common other card, so they are simply added to the top count.
+    template <bool Joker>
+    uint32_t packed_key(const hand& h) {
+        std::array<int, MAX> counts{};
+        uint32_t key = 0;
+        for (card c : h) {
+            ++counts[size_t(c)];
+            key = key << 4 | uint32_t(c);
         }
-
-        void set_types() {
-            std::array<int, MAX> counts{};
-            for (card c : *this) {
-                ++counts[c];
-            }
-            type = determine_type(counts);
+        int jokers = Joker ? std::exchange(counts[JOKER], 0) : 0;
+        int top = 0, second = 0;
+        for (int count : counts) {
+            if (count > top)
+                second = std::exchange(top, count);
+            else if (count > second)
+                second = count;
         }
+        top += jokers;
+
+        HAND_TYPES type = top == 5                  ? FIVE_KIND
+                          : top == 4                ? FOUR_KIND
+                          : top == 3 && second == 2 ? FULL_HOUSE
+                          : top == 3                ? THREE_KIND
+                          : top == 2 && second == 2 ? TWO_PAIR
+                          : top == 2                ? ONE_PAIR
+                                                    : HIGH_CARD;
+        return uint32_t(type) << 20 | key;
+    }
 
-        void set_joker_types() { type = get_type_recursive_imp(); }
-
-        bool operator<(const hand& other) const {
-            if (type == other.type)
-                return stdr::lexicographical_compare(*this, other);
-            return type < other.type;
+    // LSD radix sort of (key << 32 | bid) entries on the 24 key bits, one byte per pass
+    void radix_sort_keys(std::vector<uint64_t>& entries) {
+        std::vector<uint64_t> scratch(entries.size());
+        for (int shift = 32; shift < 56; shift += 8) {
+            std::array<size_t, 257> offsets{};
+            for (uint64_t e : entries)
+                ++offsets[((e >> shift) & 0xff) + 1];
+            std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+            for (uint64_t e : entries)
+                scratch[offsets[(e >> shift) & 0xff]++] = e;
+            std::swap(entries, scratch);
         }
-    };
+    }
 
     struct bid : public std::pair<hand, long> {
         static card from_char(char c) {
@@ -113,16 +97,16 @@ namespace aoc2023::day07 {
     answertype solve(puzzle_options filename) {
         auto bids = get_from_input<Bid>(filename);
 
-        auto set_type_func = Joker ? &hand::set_joker_types : &hand::set_types;
-        stdr::for_each(bids, set_type_func, &bid::first);
-
-        stdr::sort(bids, std::less<>(), &bid::first);
+        std::vector<uint64_t> entries(bids.size());
+        stdr::transform(bids, entries.begin(), [](const Bid& b) {
+            return uint64_t(packed_key<Joker>(b.first)) << 32 | uint64_t(b.second);
+        });
+        radix_sort_keys(entries);
 
-        auto ordered_bids = bids | stdv::transform(&bid::second);
-        std::vector<long> winnings(bids.size());
-        stdr::transform(ordered_bids, stdv::iota(1l), winnings.begin(), std::multiplies<>());
+        long total_winnings = 0;
+        for (size_t rank = 0; rank < entries.size(); ++rank)
+            total_winnings += long(rank + 1) * long(entries[rank] & 0xffffffff);
 
-        long total_winnings = std::accumulate(winnings.begin(), winnings.end(), 0l);
         myprintf("%ld\n", total_winnings);
         return total_winnings;
     }
@@ -1,12 +1,10 @@
 #include "../../../common.h"
 
-#include <unordered_map>
-#include <unordered_set>
-#include <ox/ranges.h>
-#include <format>
 #include <numeric>
-#include <ox/array.h>
+#include <optional>
+#include <thread>
 #include <ranges>
+#include <utility>
 
 namespace aoc2023::day08 {
     enum direction { LEFT, RIGHT };
@@ -15,11 +13,22 @@ namespace aoc2023::day08 {
         using std::vector<direction>::vector;
     };
 
-    using node = std::string;
-    using destination = std::array<node, 2>;
+    // Node names are three characters out of A-Z and 0-9, read as a base-36 number so every node is a small index
+    using node = uint16_t;
+    constexpr long NAME_BASE = 36;
+    constexpr long NODE_COUNT = NAME_BASE * NAME_BASE * NAME_BASE;
 
-    struct dessert_map : public std::unordered_map<node, destination> {
-        using std::unordered_map<node, destination>::unordered_map;
+    constexpr long name_digit(char c) { return c >= 'A' && c <= 'Z' ? c - 'A' : 26 + (c - '0'); }
+
+    constexpr node intern(const char* name) {
+        return node((name_digit(name[0]) * NAME_BASE + name_digit(name[1])) * NAME_BASE + name_digit(name[2]));
+    }
+
+    constexpr bool ends_with(node n, char c) { return n % NAME_BASE == name_digit(c); }
+
+    struct dessert_map {
+        std::vector<std::array<node, 2>> next = std::vector<std::array<node, 2>>(NODE_COUNT);
+        std::vector<node> nodes;
     };
 
     dessert_map parse_map(std::istream& in) {
@@ -33,7 +42,9 @@ namespace aoc2023::day08 {
             if (line.empty())
                 continue;
             sscanf(line.c_str(), "%3s = (%3s, %3s)", start.data(), left.data(), right.data());
-            to_return[start.data()] = {left.data(), right.data()};
+            node n = intern(start.data());
+            to_return.next[n] = {intern(left.data()), intern(right.data())};
+            to_return.nodes.push_back(n);
         }
         return to_return;
     }
@@ -47,92 +58,175 @@ namespace aoc2023::day08 {
         return to_return;
     }
 
-    void move(direction dir, const dessert_map& map, node& curr) {
-        auto loc = map.find(curr);
-        if (loc == map.end()) {
-            myprintf("%s\n", curr.c_str());
-            std::unreachable();
+    // Where a walk through the whole instruction list ends up from each node, and after how many of its steps it
+    // stood on a node ending in Z
+    struct block_jump {
+        node end = 0;
+        std::vector<long> z_offsets;
+    };
+
+    std::vector<block_jump> get_block_jumps(const instructions& inst, const dessert_map& map) {
+        std::vector<block_jump> to_return(NODE_COUNT);
+        for (node n : map.nodes) {
+            block_jump& jump = to_return[n];
+            node curr = n;
+            for (long step = 0; step < long(inst.size()); ++step) {
+                if (ends_with(curr, 'Z'))
+                    jump.z_offsets.push_back(step);
+                curr = map.next[curr][inst[size_t(step)]];
+            }
+            jump.end = curr;
         }
-        curr = loc->second[dir];
+        return to_return;
     }
 
-    using final_options = std::vector<long>;
-    std::tuple<long, long, final_options> calculate_loop_length(node start, const instructions& inst,
-                                                                const dessert_map& map) {
-        std::vector<node> visited;
-        long dir = 0;
-        final_options finals;
-        int found = 0;
-        const int tofind = 1;
-        while (true) {
-            if (dir >= long(inst.size()))
-                dir = 0;
-            if (start.ends_with('Z')) {
-                finals.push_back(long(visited.size()));
-            }
-            if (auto pos = stdr::find(visited, start); start.ends_with('Z') && pos != visited.end()) {
-                if (++found >= tofind)
-                    break;
+    // A ghost's walk is a prefix followed by a cycle of `period` steps starting at step `offset`. It stands on a
+    // Z node at every step in `prefix`, and at every step in `cycle` plus any multiple of the period.
+    struct ghost {
+        long offset = 0;
+        long period = 0;
+        std::vector<long> prefix;
+        std::vector<long> cycle;
+
+        [[nodiscard]] bool at_z(long step) const {
+            if (step < offset)
+                return stdr::binary_search(prefix, step);
+            return stdr::binary_search(cycle, offset + (step - offset) % period);
+        }
+    };
+
+    // Walks a whole instruction list at a time until a node recurs at the start of the list
+    ghost analyse(node start, const std::vector<block_jump>& jumps, long block_length) {
+        std::vector<long> first_block(NODE_COUNT, -1);
+        std::vector<long> hits;
+        node curr = start;
+        long block = 0;
+        for (; first_block[curr] < 0; ++block) {
+            first_block[curr] = block;
+            for (long z : jumps[curr].z_offsets)
+                hits.push_back(block * block_length + z);
+            curr = jumps[curr].end;
+        }
+
+        ghost to_return;
+        to_return.offset = first_block[curr] * block_length;
+        to_return.period = (block - first_block[curr]) * block_length;
+        for (long hit : hits)
+            (hit < to_return.offset ? to_return.prefix : to_return.cycle).push_back(hit);
+        return to_return;
+    }
+
+    struct congruence {
+        long residue;
+        long modulus;
+    };
+
+    // Both congruences at once, if they are compatible; the moduli need not be coprime
+    std::optional<congruence> combine(congruence a, congruence b) {
+        long g = std::gcd(a.modulus, b.modulus);
+        if ((b.residue - a.residue) % g != 0)
+            return std::nullopt;
+        // a.modulus * p + b.modulus * q = g
+        long old_r = a.modulus, r = b.modulus, old_p = 1, p = 0;
+        while (r != 0) {
+            long quotient = old_r / r;
+            old_r = std::exchange(r, old_r - quotient * r);
+            old_p = std::exchange(p, old_p - quotient * p);
+        }
+        long lcm = a.modulus / g * b.modulus;
+        __int128 k = __int128((b.residue - a.residue) / g) * old_p % (b.modulus / g);
+        __int128 residue = (a.residue + k * a.modulus) % lcm;
+        return congruence{long(residue < 0 ? residue + lcm : residue), lcm};
+    }
+
+    // The first step at which every ghost stands on a Z node. Before all of them are in their cycles the first
+    // ghost's Z steps are checked one by one; after that each ghost allows a set of residues modulo its period,
+    // and the combinations are solved with the Chinese remainder theorem.
+    std::optional<long> first_common_z(const std::vector<ghost>& ghosts) {
+        long settled = stdr::max(ghosts | stdv::transform(&ghost::offset));
+        auto everywhere = [&ghosts](long step) {
+            return stdr::all_of(ghosts, [step](const ghost& g) { return g.at_z(step); });
+        };
+
+        const ghost& first = ghosts.front();
+        std::vector<long> early(first.prefix);
+        for (long repeat = 0; first.offset + repeat * first.period < settled; ++repeat) {
+            for (long c : first.cycle)
+                early.push_back(c + repeat * first.period);
+        }
+        for (long step : early) {
+            if (step < settled && everywhere(step))
+                return step;
+        }
+
+        std::vector<congruence> candidates{{0, 1}};
+        for (const ghost& g : ghosts) {
+            std::vector<congruence> next;
+            for (congruence c : candidates) {
+                for (long z : g.cycle) {
+                    if (auto both = combine(c, {z % g.period, g.period}))
+                        next.push_back(*both);
+                }
             }
-            visited.push_back(start);
-            move(inst[dir], map, start);
-            ++dir;
+            candidates = std::move(next);
         }
-        
-        auto x = stdr::find(visited, start) - visited.begin();
-        return {x, visited.size() - x, finals};
+
+        std::optional<long> best;
+        for (auto [residue, modulus] : candidates) {
+            long step = residue + std::max(0l, (settled - residue + modulus - 1) / modulus) * modulus;
+            if (!best || step < *best)
+                best = step;
+        }
+        return best;
     }
-    
+
     answertype puzzle1([[maybe_unused]] puzzle_options filename) {
         auto in = get_stream(filename);
         instructions inst = parse_instructions(in);
         dessert_map map = parse_map(in);
 
-        node start = "AAA";
+        node start = intern("AAA");
+        const node end = intern("ZZZ");
         long count = 0;
-        for (direction dir : inst | ox::ranges::views::repeat()) {
-            move(dir, map, start);
+        while (start != end) {
+            start = map.next[start][inst[size_t(count) % inst.size()]];
             ++count;
-            if (start == "ZZZ") {
-                break;
-            }
         }
 
         myprintf("%ld\n", count);
         return count;
     }
 
-    
-
     answertype puzzle2([[maybe_unused]] puzzle_options filename) {
         auto in = get_stream(filename);
         instructions inst = parse_instructions(in);
         dessert_map map = parse_map(in);
+        auto jumps = get_block_jumps(inst, map);
+
+        std::vector<node> starts;
+        stdr::copy_if(map.nodes, std::back_inserter(starts), [](node n) { return ends_with(n, 'A'); });
+
+        std::vector<ghost> ghosts(starts.size());
+        std::vector<std::thread> workers;
+        for (size_t i = 0; i < starts.size(); ++i) {
+            workers.emplace_back([&, i] { ghosts[i] = analyse(starts[i], jumps, long(inst.size())); });
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
 
-        auto starting_points_stream = map | stdv::keys | stdv::filter([](const node& s) { return s.ends_with('A'); });
-
-        auto start = *starting_points_stream.begin();
-        std::unordered_set<std::string> visited;
-
-        std::vector<long> loop_starts;
-        std::vector<long> loop_length_mod;
-        for (auto& s : starting_points_stream) {
-            auto [loop_start, loop_length, finals] = calculate_loop_length(s, inst, map);
-            myprintf("loop start %1zu => loop length %4zu\n\t", loop_start, loop_length);
-            for (long i : finals)
-                myprintf("%6zu, ", i);
-            myprintf("\n\t");
-            std::vector<long> finals_part;
-            std::transform(
-                    finals.begin() + 1, finals.end(), finals.begin(), std::back_inserter(finals_part), std::minus<>());
-            loop_length_mod.push_back(finals_part.front());
-            for (long i : finals_part)
-                myprintf("%6zu, ", i);
+        for (const ghost& g : ghosts) {
+            myprintf("loop start %6ld => loop length %6ld\n\t", g.offset, g.period);
+            for (long i : g.prefix)
+                myprintf("%6ld, ", i);
+            myprintf("| ");
+            for (long i : g.cycle)
+                myprintf("%6ld, ", i);
             myprintf("\n");
         }
 
-        auto res = std::accumulate(loop_length_mod.begin(), loop_length_mod.end(), 1l, std::lcm<long, long>);
-        myprintf("%zu\n", res);
+        long res = first_common_z(ghosts).value_or(-1);
+        myprintf("%ld\n", res);
         return res;
     }
-} // namespace aoc2023::day08
\ No newline at end of file
+} // namespace aoc2023::day08
@@ -1,7 +1,7 @@
 #include "../../../common.h"
 #include "pipes.h"
 #include <ox/types.h>
-#include <unordered_set>
+#include <cassert>
 
 namespace aoc2023::day10 {
     using namespace ox::int_alias;
@@ -36,7 +36,9 @@ namespace aoc2023::day10 {
         pipe_structure pipes(input_stream, from_char);
         auto start = pipes.calculate_start();
         pipes.traverse_path(start);
-        long answer = pipes.count_bounded();
+        // The scan is only needed to colour the picture; the count alone comes straight from the loop
+        long answer = do_print ? pipes.count_bounded() : pipes.enclosed_by_loop();
+        assert(answer == pipes.enclosed_by_loop());
         pipes.print();
         myprintf("%ld\n", answer);
         return answer;
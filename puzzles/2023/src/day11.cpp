@@ -1,119 +1,91 @@
 #include "../../../common.h"
-#include <ox/grid.h>
+#include <algorithm>
 #include <ranges>
-#include <unordered_set>
 
 namespace aoc2023::day11 {
-    struct universe : ox::grid<char> {
-        using ox::grid<char>::grid;
-        std::unordered_set<long> empty_cols;
-        std::unordered_set<long> empty_rows;
+    struct galaxy {
+        long x;
+        long y;
+    };
 
-        void print() {
-            for (long x = 0; x < dimensions[0]; ++x) {
-                for (long y = 0; y < dimensions[1]; ++y) {
-                    if (empty_row(y) || empty_column(x)) {
-                        myprintf("\033[31m%c", at(x, y));
-                    } else {
-                        myprintf("\033[0m%c", at(x, y));
-                    }
-                }
-                myprintf("\n");
-            }
-        }
+    // Expansion only ever inserts space between galaxies, so it keeps the order of the coordinates on each axis.
+    // The galaxies are sorted per axis once, and for any expansion factor the sum of distances over all pairs is
+    // one pass per axis: every coordinate is shifted by the empty lines before it (a prefix sum), and the i-th
+    // smallest one is i times larger than, minus the sum of, the ones before it.
+    struct universe {
+        std::vector<long> xs;
+        std::vector<long> ys;
+        std::vector<long> empty_cols_before;
+        std::vector<long> empty_rows_before;
 
-        void find_empty_columns() {
-            for (long col_index = 0; col_index < dimensions[1]; ++col_index) {
-                for (long row = 0; row < dimensions[0]; ++row) {
-                    if (at(col_index, row) == '#') {
-                        goto outer_continue;
-                    }
-                }
-                empty_cols.insert(col_index);
-            outer_continue:
-            }
-            for (long row_index = 0; row_index < dimensions[0]; ++row_index) {
-                for (long col = 0; col < dimensions[1]; ++col) {
-                    if (at(col, row_index) == '#') {
-                        goto outer_continue2;
-                    }
-                }
-                empty_rows.insert(row_index);
-            outer_continue2:
+        static std::vector<long> empty_before(const std::vector<long>& sorted, long size) {
+            std::vector<long> to_return(size_t(size) + 1, 0);
+            auto next = sorted.begin();
+            for (long i = 0; i < size; ++i) {
+                bool occupied = next != sorted.end() && *next == i;
+                while (next != sorted.end() && *next == i)
+                    ++next;
+                to_return[size_t(i) + 1] = to_return[size_t(i)] + !occupied;
             }
+            return to_return;
         }
 
-        bool empty_column(long col_index) const { return empty_cols.contains(col_index); }
-        bool empty_row(long row_index) const { return empty_rows.contains(row_index); }
-
-        long count_empty_columns(long start, long end) const {
-            long count = 0;
-            for (; start < end; ++start) {
-                count += empty_column(start);
+        universe(const std::vector<galaxy>& galaxies, long width, long height) {
+            xs.reserve(galaxies.size());
+            ys.reserve(galaxies.size());
+            for (auto [x, y] : galaxies) {
+                xs.push_back(x);
+                ys.push_back(y);
             }
-            return count;
-        }
-        long count_empty_row(long start, long end) const {
-            long count = 0;
-            for (; start < end; ++start) {
-                count += empty_row(start);
-            }
-            return count;
+            stdr::sort(xs);
+            stdr::sort(ys);
+            empty_cols_before = empty_before(xs, width);
+            empty_rows_before = empty_before(ys, height);
         }
 
-        std::vector<const_raw_iterator> get_galaxies() const {
-            std::vector<const_raw_iterator> to_return;
-            auto head = data.begin();
-            while (true) {
-                head = std::find(head, data.end(), '#');
-                if (head == data.end())
-                    return to_return;
-                to_return.push_back(head);
-                ++head;
+        static long axis_distances(const std::vector<long>& sorted, const std::vector<long>& empty, long expansion) {
+            long distances = 0;
+            long preceding = 0;
+            for (long i = 0; i < long(sorted.size()); ++i) {
+                long expanded = sorted[size_t(i)] + (expansion - 1) * empty[size_t(sorted[size_t(i)])];
+                distances += i * expanded - preceding;
+                preceding += expanded;
             }
+            return distances;
         }
 
-        template <long expansion>
-        long get_distance(const_raw_iterator start, const_raw_iterator end) const {
-            auto [x1, y1] = coord_from_index(start);
-            auto [x2, y2] = coord_from_index(end);
-            if (x2 < x1)
-                std::swap(x2, x1);
-            if (y2 < y1)
-                std::swap(y2, y1);
-            auto horizontal_distance = x2 - x1 + (expansion - 1) * count_empty_columns(x1, x2);
-            auto vertical_distance = y2 - y1 + (expansion - 1) * count_empty_row(y1, y2);
-            return horizontal_distance + vertical_distance;
+        [[nodiscard]] long get_pairwise_distances(long expansion) const {
+            return axis_distances(xs, empty_cols_before, expansion) + axis_distances(ys, empty_rows_before, expansion);
         }
+    };
 
-        template <long expansion>
-        long get_pairwise_distances() const {
-            auto galaxies = get_galaxies();
-            long distances = 0;
-            for (long x = 0; x < long(galaxies.size() - 1); ++x) {
-                for (long y = x + 1; y < long(galaxies.size()); y++) {
-                    distances += get_distance<expansion>(galaxies[x], galaxies[y]);
-                }
-            }
-            return distances;
+    universe read_universe(std::istream& in) {
+        std::vector<galaxy> galaxies;
+        std::string s;
+        long width = 0, height = 0;
+        while (std::getline(in, s) && !s.empty()) {
+            width = long(s.size());
+            for (auto x = s.find('#'); x != std::string::npos; x = s.find('#', x + 1))
+                galaxies.push_back({long(x), height});
+            ++height;
         }
-    };
+        return {galaxies, width, height};
+    }
 
-    answertype puzzle1([[maybe_unused]] puzzle_options filename) {
+    long solve(puzzle_options filename, long expansion) {
         auto stream = get_stream(filename);
-        universe u(stream, std::identity());
-        u.find_empty_columns();
-        long res = u.get_pairwise_distances<2>();
+        return read_universe(stream).get_pairwise_distances(expansion);
+    }
+
+    answertype puzzle1([[maybe_unused]] puzzle_options filename) {
+        long res = solve(filename, 2);
         myprintf("%ld\n", res);
         return res;
     }
 
     answertype puzzle2([[maybe_unused]] puzzle_options filename) {
-        auto stream = get_stream(filename);
-        universe u(stream, std::identity());
-        u.find_empty_columns();
-        long res = u.get_pairwise_distances<1'000'000>();
+        long res = solve(filename, 1'000'000);
         myprintf("%ld\n", res);
         return res;
     }
-} // namespace aoc2023::day11
\ No newline at end of file
+} // namespace aoc2023::day11
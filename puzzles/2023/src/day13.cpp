@@ -1,101 +1,97 @@
 #include "../../../common.h"
-#include <ox/grid.h>
-#include <numeric>
+#include <atomic>
+#include <bit>
+#include <cassert>
+#include <thread>
 
 namespace aoc2023::day13 {
-    struct maze : public ox::grid<char> {
-        using ox::grid<char>::grid;
+    // Each pattern as one bit mask per row and one per column, so comparing two lines is a single XOR
+    struct maze {
+        std::vector<uint64_t> rows;
+        std::vector<uint64_t> cols;
 
-        [[nodiscard]] bool is_mirrored_vertically(int col, int allowed_smudge = 0) const {
-            // mirrored between col - 1 and col
-            int smudge_count = 0;
+        // Smudges needed to mirror the lines between line - 1 and line, saturating at 2
+        static int smudges(const std::vector<uint64_t>& lines, size_t line) {
+            int count = 0;
+            for (size_t before = line, after = line; before > 0 && after < lines.size() && count < 2; ++after)
+                count += std::popcount(lines[--before] ^ lines[after]);
+            return std::min(count, 2);
+        }
 
-            for (long col_index = 0;; ++col_index) {
-                auto left = get(col - (col_index + 1), 0);
-                auto right = get(col + col_index, 0);
-                if (!left || !right)
-                    break;
-                for (long row = 0; row < dimensions[1]; ++row) {
-                    auto left = (*this)[col - (col_index + 1), row];
-                    auto right = (*this)[col + col_index, row];
-                    if (left != right) {
-                        ++smudge_count;
-                    }
-                    if (smudge_count > allowed_smudge) {
-                        return false;
-                    }
-                }
+        // Every candidate axis is evaluated once, filling in the note for a clean mirror (part 1) and for a mirror
+        // with exactly one smudge (part 2)
+        static void find_axes(const std::vector<uint64_t>& lines, long weight, std::array<long, 2>& notes) {
+            for (size_t line = 1; line < lines.size(); ++line) {
+                int count = smudges(lines, line);
+                if (count < 2 && notes[size_t(count)] == 0)
+                    notes[size_t(count)] = weight * long(line);
             }
-
-            return smudge_count == allowed_smudge;
         }
 
-        [[nodiscard]] bool is_mirrored_horizontally(int row, int allowed_smudge = 0) const {
-            // mirrored between row - 1 and row
-            int smudge_count = 0;
+        [[nodiscard]] std::array<long, 2> find_mirrors() const {
+            std::array<long, 2> notes{};
+            find_axes(cols, 1, notes);
+            find_axes(rows, 100, notes);
+            return notes;
+        }
+    };
 
-            for (long row_index = 0;; ++row_index) {
-                auto left = get(0l, row - (row_index + 1));
-                auto right = get(0l, row + row_index);
-                if (!left || !right)
-                    break;
-                for (long col = 0; col < dimensions[0]; ++col) {
-                    auto left = (*this)[col, row - (row_index + 1)];
-                    auto right = (*this)[col, row + row_index];
-                    if (left != right) {
-                        ++smudge_count;
-                    }
-                    if (smudge_count > allowed_smudge) {
-                        return false;
-                    }
+    STREAM_IN(maze, m) {
+        m = maze{};
+        std::string s;
+        while (std::getline(in, s) && !s.empty()) {
+            assert(s.size() <= 64 && m.rows.size() < 64);
+            if (m.cols.empty())
+                m.cols.resize(s.size());
+            uint64_t row = 0;
+            for (size_t x = 0; x < s.size(); ++x) {
+                if (s[x] == '#') {
+                    row |= uint64_t(1) << x;
+                    m.cols[x] |= uint64_t(1) << m.rows.size();
                 }
             }
-
-            return smudge_count == allowed_smudge;
+            m.rows.push_back(row);
         }
+        if (!m.rows.empty())
+            in.clear(in.rdstate() & ~std::ios::failbit);
+        return in;
+    }
 
-        [[nodiscard]] long find_mirror(int smudge = 0) const {
+    std::array<long, 2> summarize(puzzle_options filename) {
+        auto data = get_stream<maze>(filename);
+        std::vector<maze> patterns(data.begin(), data.end());
 
-            long sum = 0;
-            for(int col = 1; col < dimensions[0]; ++col) {
-                if (is_mirrored_vertically(col, smudge)) {
-                    return col;
+        std::atomic<size_t> next = 0;
+        std::atomic<long> clean = 0;
+        std::atomic<long> smudged = 0;
+        std::vector<std::thread> workers;
+        for (unsigned w = 0; w < std::max(1u, std::thread::hardware_concurrency()); ++w) {
+            workers.emplace_back([&] {
+                std::array<long, 2> local{};
+                for (size_t i; (i = next++) < patterns.size();) {
+                    auto notes = patterns[i].find_mirrors();
+                    local[0] += notes[0];
+                    local[1] += notes[1];
                 }
-            }
-            for(int row = 1; row < dimensions[1]; ++row) {
-                if (is_mirrored_horizontally(row, smudge)) {
-                    return 100 * row;
-                }
-            }
-            return sum;
+                clean += local[0];
+                smudged += local[1];
+            });
         }
-    };
-
-    STREAM_IN(maze, m) {
-        if (in.eof()) {
-            in.setstate(std::ios::failbit);
-            return in;
+        for (auto& worker : workers) {
+            worker.join();
         }
-        auto rows = stdv::istream<ox::line>(in) | stdv::take_while(std::not_fn(&std::string::empty));
-        m = maze(rows, std::identity());
-        if (in.eof())
-            in.clear(std::istream::eofbit);
-        return in;
+        return {clean.load(), smudged.load()};
     }
 
     answertype puzzle1([[maybe_unused]] puzzle_options filename) {
-        auto data = get_stream<maze>(filename);
-        auto mirror_notes = data | stdv::transform([](const maze& m) { return m.find_mirror(0); } );
-        long res = std::accumulate(mirror_notes.begin(), mirror_notes.end(), 0l);
+        long res = summarize(filename)[0];
         myprintf("%ld\n", res);
         return res;
     }
 
     answertype puzzle2([[maybe_unused]] puzzle_options filename) {
-        auto data = get_stream<maze>(filename);
-        auto mirror_notes = data | stdv::transform([](const maze& m) { return m.find_mirror(1); } );
-        long res = std::accumulate(mirror_notes.begin(), mirror_notes.end(), 0l);
+        long res = summarize(filename)[1];
         myprintf("%ld\n", res);
         return res;
     }
-} // namespace aoc2023::day13
\ No newline at end of file
+} // namespace aoc2023::day13
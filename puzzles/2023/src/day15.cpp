@@ -1,129 +1,202 @@
 #include "../../../common.h"
 #include <algorithm>
-#include <unordered_map>
-#include <cassert>
-#include <limits>
-#include <numeric>
+#include <array>
+#include <bit>
+#include <optional>
+#include <string_view>
+#include <utility>
 
 namespace aoc2023::day15 {
     enum OP : char { ADD = '=', REMOVE = '-' };
 
     struct instruction {
-        std::string key;
+        std::string_view key;
         int value;
         OP op;
     };
 
-    struct csv_string : std::string {
-        [[nodiscard]] instruction split() const {
-            instruction to_return;
-            auto op_pos = this->find_first_of("=-");
-            to_return.op = OP((*this)[op_pos]);
-            to_return.key = this->substr(0, op_pos);
-            if (to_return.op == ADD) {
-                to_return.value = atoi(this->c_str() + op_pos + 1);
-            } else {
-                to_return.value = 0;
-            }
-            return to_return;
+    // The comma separated steps as views into the input, without copying any of them out
+    std::vector<std::string_view> tokenize(std::string_view input) {
+        std::vector<std::string_view> to_return;
+        to_return.reserve(size_t(stdr::count(input, ',')) + 1);
+        for (size_t start = 0; start < input.size();) {
+            size_t end = std::min(input.find(',', start), input.size());
+            to_return.push_back(input.substr(start, end - start));
+            start = end + 1;
         }
-    };
+        return to_return;
+    }
 
-    int HASH(const std::string& s) {
-        int res = 0;
-        for (char c : s) {
-            res += c;
-            res *= 17;
-            res %= 256;
+    instruction split(std::string_view step) {
+        auto op_pos = step.find_first_of("=-");
+        instruction to_return{step.substr(0, op_pos), 0, OP(step[op_pos])};
+        if (to_return.op == ADD) {
+            for (char c : step.substr(op_pos + 1))
+                to_return.value = to_return.value * 10 + (c - '0');
         }
-        return res;
+        return to_return;
+    }
+
+    // HASH of `lanes` strings side by side. The strings are first transposed so that round r holds the r-th
+    // character of every string, after which each round is the same byte arithmetic on every lane (wrapping at
+    // 256 for free), which the compiler turns into vector instructions.
+    template <size_t lanes = 32>
+    std::vector<uint8_t> HASH(const std::vector<std::string_view>& strings) {
+        std::vector<uint8_t> to_return(strings.size());
+        std::vector<std::array<uint8_t, lanes>> columns;
+        for (size_t first = 0; first < strings.size(); first += lanes) {
+            size_t count = std::min(lanes, strings.size() - first);
+            std::array<uint8_t, lanes> hash{};
+            std::array<size_t, lanes> length{};
+            size_t rounds = 0;
+            for (size_t l = 0; l < count; ++l) {
+                length[l] = strings[first + l].size();
+                rounds = std::max(rounds, length[l]);
+            }
+            columns.assign(rounds, {});
+            for (size_t l = 0; l < count; ++l) {
+                for (size_t r = 0; r < length[l]; ++r)
+                    columns[r][l] = uint8_t(strings[first + l][r]);
+            }
+            for (size_t r = 0; r < rounds; ++r) {
+                for (size_t l = 0; l < lanes; ++l) {
+                    uint8_t next = uint8_t((hash[l] + columns[r][l]) * 17);
+                    hash[l] = r < length[l] ? next : hash[l];
+                }
+            }
+            std::copy_n(hash.begin(), count, to_return.begin() + long(first));
+        }
+        return to_return;
     }
 
+    // Lenses are kept in one array in the order they were placed, and every box lists the indices of its lenses in
+    // that order. Removing a lens only marks it dead, and a label finds its live lens through an open-addressing
+    // table, so placing, replacing and removing are all O(1).
     class HASHMAP {
-        using value_type = std::pair<std::string, int>;
-        using bucket_type = std::vector<value_type>;
+        struct lens {
+            std::string_view label;
+            int focal_length;
+            bool alive;
+        };
+
+        static constexpr int32_t empty = -1;
+        static constexpr int32_t removed = -2;
+
+        std::vector<lens> lenses;
+        std::array<std::vector<uint32_t>, 256> buckets;
+        std::vector<int32_t> table = std::vector<int32_t>(64, empty);
+        size_t table_used = 0;
+
+        // The slot holding the live lens for this label, or else the slot a new one should go to
+        [[nodiscard]] std::pair<size_t, bool> probe(std::string_view label) const {
+            size_t mask = table.size() - 1;
+            std::optional<size_t> insert_at;
+            for (size_t i = std::hash<std::string_view>()(label) & mask;; i = (i + 1) & mask) {
+                if (table[i] == empty)
+                    return {insert_at.value_or(i), false};
+                if (table[i] == removed) {
+                    if (!insert_at)
+                        insert_at = i;
+                } else if (lenses[size_t(table[i])].label == label) {
+                    return {i, true};
+                }
+            }
+        }
+
+        void rehash() {
+            std::vector<int32_t> old = std::exchange(table, {});
+            size_t live = size_t(stdr::count_if(old, [](int32_t i) { return i >= 0; }));
+            table.assign(std::max<size_t>(64, std::bit_ceil(4 * live)), empty);
+            table_used = live;
+            for (int32_t index : old) {
+                if (index >= 0)
+                    table[probe(lenses[size_t(index)].label).first] = index;
+            }
+        }
+
     public:
-        std::vector<bucket_type> buckets{256};
-        int& operator[](const std::string& key) {
-            bucket_type& bucket = buckets[HASH(key)];
-            if (auto pos = stdr::find_if(bucket, [&](const value_type& v) { return v.first == key; });
-                pos != bucket.end()) {
-                return pos->second;
-            } else {
-                bucket.emplace_back(key, 0);
-                return bucket.back().second;
+        void place(std::string_view label, uint8_t box, int focal_length) {
+            auto [slot, found] = probe(label);
+            if (found) {
+                lenses[size_t(table[slot])].focal_length = focal_length;
+                return;
+            }
+            table_used += table[slot] == empty;
+            table[slot] = int32_t(lenses.size());
+            buckets[box].push_back(uint32_t(lenses.size()));
+            lenses.push_back({label, focal_length, true});
+            if (2 * table_used > table.size())
+                rehash();
+        }
+
+        void erase(std::string_view label) {
+            if (auto [slot, found] = probe(label); found) {
+                lenses[size_t(table[slot])].alive = false;
+                table[slot] = removed;
             }
         }
 
-        void erase(const std::string& key) {
-            bucket_type& bucket = buckets[HASH(key)];
-            if (auto pos = stdr::find_if(bucket, [&](const value_type& v) { return v.first == key; });
-                pos != bucket.end()) {
-                bucket.erase(pos);
+        template <typename F>
+        void for_each_lens(size_t box, F f) const {
+            for (uint32_t index : buckets[box]) {
+                if (lenses[index].alive)
+                    f(lenses[index]);
             }
         }
     };
 
-    std::istream& operator>>(std::istream& in, std::string& s) {
-        return std::getline(in, s, ',');
+    std::string get_steps(puzzle_options filename) {
+        auto input = get_stream<char>(filename);
+        return {input.begin(), input.end()};
     }
 
     answertype puzzle1([[maybe_unused]] puzzle_options filename) {
-        auto instructions = get_stream<csv_string>(filename);
-        auto hashes = instructions | stdv::transform(HASH);
-        int res = std::accumulate(hashes.begin(), hashes.end(), 0);
-        printf("%d\n", res);
+        std::string input = get_steps(filename);
+        auto hashes = HASH(tokenize(input));
+        long res = 0;
+        for (uint8_t hash : hashes)
+            res += hash;
+        myprintf("%ld\n", res);
         return res;
     }
 
     answertype puzzle2([[maybe_unused]] puzzle_options filename) {
-        HASHMAP hashmap;
+        std::string input = get_steps(filename);
+        std::vector<instruction> instructions;
+        std::vector<std::string_view> keys;
+        for (std::string_view step : tokenize(input)) {
+            instructions.push_back(split(step));
+            keys.push_back(instructions.back().key);
+        }
+        auto boxes = HASH(keys);
 
-        auto instructions_strings = get_stream<csv_string>(filename);
-        auto instructions = instructions_strings | stdv::transform(&csv_string::split);
-        for (const auto& [key, value, op] : instructions) {
+        HASHMAP hashmap;
+        for (size_t i = 0; i < instructions.size(); ++i) {
+            const auto& [key, value, op] = instructions[i];
             switch (op) {
-                case ADD: hashmap[key] = value; break;
+                case ADD: hashmap.place(key, boxes[i], value); break;
                 case REMOVE: hashmap.erase(key);
             }
         }
 
-#ifdef __cpp_lib_ranges_enumerate
-        for (const auto& [i, bucket] : hashmap.buckets | stdv::enumerate) {
-            printf("BOX %3ld:\t", i + 1);
-            printf("[");
-            for (auto [key, value] : bucket)
-                printf("(%s, %d), ", key.c_str(), value);
-            printf("]\n");
-        }
-
         long res = 0l;
-        for (const auto& [bucket_index, bucket] : hashmap.buckets | stdv::enumerate) {
-            for (const auto& [lens_index, lens] : bucket | stdv::values | stdv::enumerate) {
-                res += (bucket_index + 1) * (lens_index + 1) * lens;
-            }
-        }
-#else
-        for (int i = 0; i < 256; ++i) {
-            const auto& bucket = hashmap.buckets[i];
-            printf("BOX %3d:\t", i + 1);
-            printf("[");
-            for (auto [key, value] : bucket)
-                printf("(%s, %d), ", key.c_str(), value);
-            printf("]\n");
+        for (size_t box = 0; box < 256; ++box) {
+            long lens_index = 0;
+            hashmap.for_each_lens(box, [&](const auto& lens) {
+                res += long(box + 1) * ++lens_index * lens.focal_length;
+            });
         }
 
-        long res = 0l;
-        for (int bucket_index = 0; bucket_index < 256; ++bucket_index) {
-            const auto& bucket = hashmap.buckets[bucket_index];
-            for (int lens_index = 0; lens_index < int(bucket.size()); ++lens_index) {
-                const auto& lens = bucket[lens_index].second;
-                res += (bucket_index + 1) * (lens_index + 1) * lens;
-            }
+        for (size_t box = 0; box < 256; ++box) {
+            myprintf("BOX %3zu:\t", box + 1);
+            myprintf("[");
+            hashmap.for_each_lens(box, [](const auto& lens) {
+                myprintf("(%.*s, %d), ", int(lens.label.size()), lens.label.data(), lens.focal_length);
+            });
+            myprintf("]\n");
         }
-#endif
 
-        printf("%ld\n", res);
+        myprintf("%ld\n", res);
         return res;
     }
-} // namespace aoc2023::day15
\ No newline at end of file
+} // namespace aoc2023::day15
@@ -3,7 +3,8 @@
 #include <format>
 #include <ox/formatting.h>
 #include <ox/colors.h>
-#include <ox/polygon.h>
+#include <limits>
+#include <utility>
 
 namespace aoc2023::day18 {
     struct dig_directions {
@@ -38,29 +39,61 @@ namespace aoc2023::day18 {
         return out << ox::color(d.color) << d.dir << " " << d.amount << ox::format{ox::escape::reset} << std::endl;
     }
 
-    std::array<long, 2> move(std::array<long, 2> pos, char dir, long distance = 1) {
-        switch (dir) {
-            case 'U': return {pos[0], pos[1] - distance};
-            case 'L': return {pos[0] - distance, pos[1]};
-            case 'D': return {pos[0], pos[1] + distance};
-            case 'R': return {pos[0] + distance, pos[1]};
-            default: std::unreachable();
+    // Area and perimeter of the dug loop, updated as each instruction arrives so the plan never has to be held in
+    // memory. Everything is 128-bit, as plans with billions of long steps overflow 64-bit shoelace sums.
+    struct lagoon {
+        __int128 x = 0;
+        __int128 y = 0;
+        __int128 twice_area = 0;
+        __int128 perimeter = 0;
+
+        void dig(char dir, __int128 distance) {
+            __int128 next_x = x, next_y = y;
+            switch (dir) {
+                case 'U': next_y -= distance; break;
+                case 'L': next_x -= distance; break;
+                case 'D': next_y += distance; break;
+                case 'R': next_x += distance; break;
+                default: std::unreachable();
+            }
+            twice_area += x * next_y - next_x * y;
+            perimeter += distance;
+            x = next_x;
+            y = next_y;
+        }
+
+        // Pick's theorem gives the cells strictly inside the loop through the trench centres as A - P/2 + 1, and the
+        // P trench cells themselves come on top of that
+        [[nodiscard]] __int128 volume() const {
+            return (twice_area < 0 ? -twice_area : twice_area) / 2 + perimeter / 2 + 1;
         }
+    };
+
+    std::string to_string(__int128 value) {
+        std::string to_return;
+        bool negative = value < 0;
+        do {
+            __int128 digit = value % 10;
+            to_return += char('0' + (digit < 0 ? -digit : digit));
+            value /= 10;
+        } while (value != 0);
+        if (negative)
+            to_return += '-';
+        return {to_return.rbegin(), to_return.rend()};
     }
 
     answertype solve(puzzle_options filename, char dig_directions::* direction, uint32_t dig_directions::* amount) {
-        auto input = get_from_input<dig_directions>(filename);
-        ox::polygon<long> p;
-        std::array pos{0l, 0l};
-        for (auto inst : input) {
-            p.points.emplace_back(pos[0], pos[1]);
-            pos = move(pos, inst.*direction, inst.*amount);
-        }
+        lagoon l;
+        for (const dig_directions& inst : get_stream<dig_directions>(filename))
+            l.dig(inst.*direction, inst.*amount);
 
-        long res2 = long(p.area()) + long(p.perimeter()) / 2 + 1;
-        printf("%ld\n", res2);
+        __int128 res = l.volume();
+        std::string res_string = to_string(res);
+        myprintf("%s\n", res_string.c_str());
 
-        return res2;
+        if (res > std::numeric_limits<long>::max())
+            return res_string;
+        return long(res);
     }
 
     answertype puzzle1([[maybe_unused]] puzzle_options filename) {
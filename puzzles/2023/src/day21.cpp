@@ -1,304 +1,170 @@
 #include "../../../common.h"
-#include <ox/grid.h>
-#include <set>
-#include <unordered_set>
-#include <string_view>
-#include <format>
+#include <bit>
 #include <cassert>
+#include <map>
+#include <optional>
 
 namespace aoc2023::day21 {
-    constexpr static long INPUT_WIDTH = 131;
-    constexpr static long MIDPOINT = INPUT_WIDTH / 2;
-    constexpr static long STEPS = 26501365;
-    constexpr static long LOOPS = (STEPS - (MIDPOINT)) / INPUT_WIDTH;
-    constexpr static long LOOPS_WIDTH = 2 * LOOPS + 1;
-
-    template <typename T>
-    concept has_unique_object_representations = std::has_unique_object_representations_v<T>;
+    using word = uint64_t;
+    constexpr size_t word_bits = 64;
+    constexpr long PART_1_STEPS = 64;
+    constexpr long PART_2_STEPS = 26501365;
+    constexpr long MAX_SAMPLES = 40;
+
+    struct flower_map {
+        std::vector<std::string> rows;
+        long start_x = 0;
+        long start_y = 0;
+
+        explicit flower_map(std::istream& in) {
+            std::string s;
+            while (std::getline(in, s) && !s.empty()) {
+                if (auto x = s.find('S'); x != std::string::npos) {
+                    start_x = long(x);
+                    start_y = long(rows.size());
+                }
+                rows.push_back(s);
+            }
+        }
 
-    static auto trivial_hash = []<has_unique_object_representations T>(const T& data) {
-        std::string_view ss((char*) &data, sizeof(data));
-        return std::hash<std::string_view>()(ss);
+        [[nodiscard]] long width() const { return long(rows.front().size()); }
+        [[nodiscard]] long height() const { return long(rows.size()); }
     };
 
-    struct flower_map : ox::grid<char> {
-        using ox::grid<char>::grid;
-        using ox::grid<char>::const_raw_iterator;
-
-        [[nodiscard]] const_raw_iterator find_start() const { return stdr::find(data, 'S'); }
-
-        void print(const std::set<flower_map::const_raw_iterator>& highlight) const {
-            leveled_iterators(
-                    [&](auto c) {
-                        if (highlight.contains(c)) {
-                            myprintf("\033[41m ");
-                        } else {
-                            if (auto [x, y] = coord_from_index(c); x % 131 == 0 || y % 131 == 0)
-                                myprintf("\033[44m%c\033[0m", *c);
-                            else
-                                myprintf("\033[0m%c", *c);
-                        }
-                    },
-                    []() { myprintf("\033[0m\n"); });
-        }
+    // The map repeated in every direction far enough that `max_steps` steps from the start never reach the edge.
+    // Both the garden plots and the frontier are bit-planes, one padded row of words per line, so one step is
+    // next = (left | right | up | down of current) & plots, computed a word at a time.
+    class tiled_garden {
+        std::vector<word> plots;
+        std::vector<word> current;
+        std::vector<word> next;
+        size_t words = 0;
+        size_t stride = 0;
+        size_t side_x = 0;
+        size_t side_y = 0;
+        size_t start_x = 0;
+        size_t start_y = 0;
+        size_t radius = 0;
+
+        [[nodiscard]] size_t word_index(size_t x, size_t y) const { return (y + 1) * stride + 1 + x / word_bits; }
+
+    public:
+        tiled_garden(const flower_map& map, long max_steps) {
+            long tiles_x = max_steps / map.width() + 1;
+            long tiles_y = max_steps / map.height() + 1;
+            side_x = size_t((2 * tiles_x + 1) * map.width());
+            side_y = size_t((2 * tiles_y + 1) * map.height());
+            words = (side_x + word_bits - 1) / word_bits;
+            stride = words + 2;
+            plots.assign(stride * (side_y + 2), 0);
+            current.assign(plots.size(), 0);
+            next.assign(plots.size(), 0);
+
+            for (size_t y = 0; y < side_y; ++y) {
+                const std::string& row = map.rows[y % map.rows.size()];
+                for (size_t x = 0; x < side_x; ++x) {
+                    if (row[x % row.size()] != '#')
+                        plots[word_index(x, y)] |= word(1) << (x % word_bits);
+                }
+            }
 
-        void print(const std::set<flower_map::const_raw_iterator>& highlight,
-                   const std::set<flower_map::const_raw_iterator>& seen) const {
-            leveled_iterators(
-                    [&](auto c) {
-                        if (highlight.contains(c)) {
-                            myprintf("\033[41m ");
-                        } else if (seen.contains(c)) {
-                            myprintf("\033[42m ");
-                        } else {
-                            myprintf("\033[0m%c", *c);
-                        }
-                    },
-                    []() { myprintf("\033[0m\n"); });
+            start_x = size_t(tiles_x * map.width() + map.start_x);
+            start_y = size_t(tiles_y * map.height() + map.start_y);
+            current[word_index(start_x, start_y)] |= word(1) << (start_x % word_bits);
         }
 
-        void print(const std::unordered_set<std::array<long, 2>, decltype(trivial_hash)>& highlight,
-                   const std::unordered_set<std::array<long, 2>, decltype(trivial_hash)>& seen) const {
-            for (long j = 0; j < long(get_height()); ++j) {
-                for (long i = 0; i < long(get_width()); ++i) {
-                    if (highlight.contains({i, j})) {
-                        myprintf("\033[41m ");
-                    } else if (seen.contains({i, j})) {
-                        myprintf("\033[42m ");
-                    } else {
-                        myprintf("\033[0m%c", (*this)[i, j]);
-                    }
+        // Advances the frontier by one step and returns how many plots it covers. Only the rows and words within
+        // the step count of the start can have been reached.
+        long step() {
+            long count = 0;
+            ++radius;
+            size_t first_word = start_x >= radius ? 1 + (start_x - radius) / word_bits : 1;
+            size_t last_word = std::min(words, 1 + (start_x + radius) / word_bits);
+            size_t first_row = start_y >= radius ? 1 + start_y - radius : 1;
+            size_t last_row = std::min(side_y, 1 + start_y + radius);
+            for (size_t y = first_row; y <= last_row; ++y) {
+                const word* up = &current[(y - 1) * stride];
+                const word* mid = up + stride;
+                const word* down = mid + stride;
+                for (size_t w = first_word; w <= last_word; ++w) {
+                    word from_left = (mid[w] << 1) | (mid[w - 1] >> 63);
+                    word from_right = (mid[w] >> 1) | (mid[w + 1] << 63);
+                    word reached = (from_left | from_right | up[w] | down[w]) & plots[y * stride + w];
+                    next[y * stride + w] = reached;
+                    count += std::popcount(reached);
                 }
-                myprintf("\033[0m\n");
             }
+            std::swap(current, next);
+            return count;
         }
     };
 
-    using positions = std::set<flower_map::const_raw_iterator>;
-    using positions2 = std::unordered_set<std::array<long, 2>, decltype(trivial_hash)>;
-    using area_map = std::unordered_map<char, long>;
-
-    long calculate_area(const area_map& even, const area_map& odd) {
-        using namespace std::string_literals;
-        auto get_area_part_even = [even](char c) {
-            return c ? even.at(c) : 0l;
-        };
-        auto get_area_even = [&get_area_part_even](const auto& s) {
-            return stdr::fold_left(s | stdv::transform(get_area_part_even), 0l, std::plus());
-        };
-
-
-        long full_even = stdr::fold_left(even | stdv::values, 0l, std::plus());
-        long full_odd = stdr::fold_left(odd | stdv::values, 0l, std::plus());
-        long top = full_even - get_area_even("AB");
-        long bottom = full_even - get_area_even("CD");
-        long right = full_even - get_area_even("BD");
-        long left = full_even - get_area_even("AC");
-
-        long NE1 = full_even - even.at('B');
-        long NE2 = odd.at('C');
-
-        long NW1 = full_even - even.at('A');
-        long NW2 = odd.at('D');
-
-        long SE1 = full_even - even.at('D');
-        long SE2 = odd.at('A');
-
-        long SW1 = full_even - even.at('C');
-        long SW2 = odd.at('B');
-
-        long perimeter_area = 0;
-
-        perimeter_area += top;
-        perimeter_area += (LOOPS - 1) * (NE1 + NE2) + NE2;
-        perimeter_area += right;
-        perimeter_area += (LOOPS - 1) * (SE1 + SE2) + SE2;
-        perimeter_area += bottom;
-        perimeter_area += (LOOPS - 1) * (SW1 + SW2) + SW2;
-        perimeter_area += left;
-        perimeter_area += (LOOPS - 1) * (NW1 + NW2) + NW2;
-
-        long inner_area = 0;
-        for (long x = 1; x < LOOPS_WIDTH - 1; ++x) {
-            long s_x = std::min(x, LOOPS_WIDTH - x - 1);
-            for (long y = LOOPS - s_x + 1; y < LOOPS + s_x; ++y) {
-                inner_area += (x + y) % 2 == 0 ? full_even : full_odd;
-            }
+    // Plots reachable in exactly each of `steps` steps, from a single walk of the frontier
+    std::map<long, long> measure(const flower_map& map, const std::vector<long>& steps) {
+        long max_steps = stdr::max(steps);
+        tiled_garden garden(map, max_steps);
+        std::map<long, long> to_return;
+        long count = 1;
+        for (long s = 0; s <= max_steps; ++s) {
+            if (stdr::find(steps, s) != steps.end())
+                to_return[s] = count;
+            if (s < max_steps)
+                count = garden.step();
         }
-
-        return perimeter_area + inner_area;
-    }
-
-    /*
-     A A A A O B B B B
-     A A A I P J B B B
-     A A I E P F J B B
-     A I E E P F F J B
-     K R R R T S S S L
-     C M G G Q H H N D
-     C C M G Q H N D D
-     C C C M Q N D D D
-     C C C C U D D D D
-     */
-
-    void area_test(const area_map& amap, const positions2& pos) {
-#ifdef __cpp_lib_print
-        std::print("{}\n", amap);
-#endif
-        assert(stdr::fold_left(amap | stdv::values, 0l, std::plus()) == long(pos.size()));
-    }
-
-#define DEFINE_CALCULATE_CORNER(X, BODY) \
-    long calculate_##X(const positions2& seen, positions2& checked) { \
-        long count = 0; \
-        for (long i = 0; i < MIDPOINT; ++i) { \
-            for (long j = 0; j < MIDPOINT - i; ++j) { \
-                assert(!checked.contains BODY); \
-                count += seen.contains BODY; \
-                checked.insert BODY; \
-            }; \
-        } \
-        return count; \
-    }
-
-#define DEFINE_CALCULATE_INNER(X, BODY) \
-    long calculate_##X(const positions2& seen, positions2& checked) { \
-        long count = 0; \
-        for (long i = 2; i < MIDPOINT; ++i) { \
-            for (long j = MIDPOINT + 1 - i; j < MIDPOINT; ++j) { \
-                assert(!checked.contains BODY); \
-                count += seen.contains BODY; \
-                checked.insert BODY; \
-            }; \
-        } \
-        return count; \
-    }
-
-#define DEFINE_CALCULATE_LINE(X, BODY) \
-    long calculate_##X(const positions2& seen, positions2& checked) { \
-        long count = 0; \
-        for (long i = 1; i < MIDPOINT; ++i) { \
-            [[maybe_unused]] long j = i; \
-            assert(!checked.contains BODY); \
-            count += seen.contains BODY; \
-            checked.insert BODY; \
-        } \
-        return count; \
-    }
-
-#define DEFINE_CALCULATE_POINTS(X, POINT) \
-    long calculate_##X(const positions2& seen, positions2& checked) { \
-        assert(!checked.contains POINT); \
-        checked.insert POINT; \
-        return seen.contains POINT; \
-    }
-
-#define MIRROR(X) (INPUT_WIDTH - (X) -1)
-
-    DEFINE_CALCULATE_CORNER(A, ({i, j}))
-    DEFINE_CALCULATE_CORNER(B, ({MIRROR(i), j}))
-    DEFINE_CALCULATE_CORNER(C, ({i, MIRROR(j)}))
-    DEFINE_CALCULATE_CORNER(D, ({MIRROR(i), MIRROR(j)}))
-
-    DEFINE_CALCULATE_INNER(E, ({i, j}))
-    DEFINE_CALCULATE_INNER(F, ({MIRROR(i), j}))
-    DEFINE_CALCULATE_INNER(G, ({i, MIRROR(j)}))
-    DEFINE_CALCULATE_INNER(H, ({MIRROR(i), MIRROR(j)}))
-
-    DEFINE_CALCULATE_LINE(I, ({MIRROR(i + MIDPOINT), j}))
-    DEFINE_CALCULATE_LINE(J, ({i + MIDPOINT, j}))
-    DEFINE_CALCULATE_LINE(M, ({i, j + MIDPOINT}))
-    DEFINE_CALCULATE_LINE(N, ({MIRROR(i), j + MIDPOINT}))
-    DEFINE_CALCULATE_LINE(P, ({INPUT_WIDTH / 2, j}))
-    DEFINE_CALCULATE_LINE(Q, ({INPUT_WIDTH / 2, j + MIDPOINT}))
-    DEFINE_CALCULATE_LINE(R, ({i, INPUT_WIDTH / 2}))
-    DEFINE_CALCULATE_LINE(S, ({i + MIDPOINT, INPUT_WIDTH / 2}))
-
-    DEFINE_CALCULATE_POINTS(K, ({0, MIDPOINT}))
-    DEFINE_CALCULATE_POINTS(L, ({INPUT_WIDTH - 1, MIDPOINT}))
-    DEFINE_CALCULATE_POINTS(O, ({MIDPOINT, 0}))
-    DEFINE_CALCULATE_POINTS(U, ({MIDPOINT, INPUT_WIDTH - 1}))
-    DEFINE_CALCULATE_POINTS(T, ({MIDPOINT, MIDPOINT}))
-
-#define ADD_AREA(X) to_return[*#X] = calculate_##X(seen, checked)
-
-    area_map get_area_part(const positions2& seen) {
-        area_map to_return;
-        positions2 checked;
-        ADD_AREA(A);
-        ADD_AREA(B);
-        ADD_AREA(C);
-        ADD_AREA(D);
-        ADD_AREA(E);
-        ADD_AREA(F);
-        ADD_AREA(G);
-        ADD_AREA(H);
-        ADD_AREA(I);
-        ADD_AREA(J);
-        ADD_AREA(K);
-        ADD_AREA(L);
-        ADD_AREA(M);
-        ADD_AREA(N);
-        ADD_AREA(O);
-        ADD_AREA(P);
-        ADD_AREA(Q);
-        ADD_AREA(R);
-        ADD_AREA(S);
-        ADD_AREA(T);
-        ADD_AREA(U);
-        assert(checked.size() == (INPUT_WIDTH * INPUT_WIDTH));
         return to_return;
     }
 
-    positions calculate_steps(flower_map& map, flower_map::const_raw_iterator start, long num_steps) {
-        positions curr{start};
-
-        std::string line;
-
-        for (long count = 0; count < num_steps; ++count) {
-            positions next;
-            for (auto pos : curr) {
-                auto neighbours = map.cardinal_neighbour_range(pos);
-                for (auto adj : neighbours | flower_map::const_valid_index()) {
-                    if (*adj == '.' or *adj == 'S') {
-                        next.insert(adj);
-                    }
-                }
-            }
-            std::swap(curr, next);
-            next.clear();
+    // Walks short distances directly. Past a few map widths the reachable area grows quadratically in whole map
+    // widths, so it is sampled every map width with the same remainder as `steps`, and once the third differences
+    // of the samples stay at zero it is extrapolated from three of them. Takes more samples when they haven't
+    // settled, up to MAX_SAMPLES map widths, and gives up after that.
+    std::optional<long> reachable(const flower_map& map, long steps) {
+        long period = map.width();
+        assert(map.width() == map.height());
+        long first = steps % period + period;
+        if (steps <= first + (MAX_SAMPLES - 1) * period)
+            return measure(map, {steps})[steps];
+        for (long samples = 5; samples <= MAX_SAMPLES; samples *= 2) {
+            std::vector<long> sample_steps;
+            for (long k = 0; k < samples; ++k)
+                sample_steps.push_back(first + k * period);
+            auto counts = measure(map, sample_steps);
+            std::vector<long> f;
+            for (long s : sample_steps)
+                f.push_back(counts[s]);
+
+            auto third_difference = [&f](size_t i) { return f[i + 3] - 3 * f[i + 2] + 3 * f[i + 1] - f[i]; };
+            size_t settled = f.size() - 3;
+            while (settled > 0 && third_difference(settled - 1) == 0)
+                --settled;
+            if (settled + 5 > f.size())
+                continue;
+
+            long d1 = f[settled + 1] - f[settled];
+            long d2 = f[settled + 2] - 2 * f[settled + 1] + f[settled];
+            long n = (steps - sample_steps[settled]) / period;
+            return f[settled] + n * d1 + n * (n - 1) / 2 * d2;
         }
-
-        return curr;
+        return std::nullopt;
     }
 
-    positions2 pos_to_pos2(const flower_map& map, const positions& data) {
-        auto x = data | stdv::transform([&map](auto y) { return map.coord_from_index(y); });
-        return positions2{x.begin(), x.end()};
-    };
-
     answertype puzzle1([[maybe_unused]] puzzle_options filename) {
-        auto input = get_stream(filename);
+        auto input = get_stream<ox::line>(filename);
         flower_map map(input);
-        positions res = calculate_steps(map, map.find_start(), 64);
-        myprintf("%zu\n", res.size());
-        return res.size();
+        long res = *reachable(map, PART_1_STEPS);
+        myprintf("%ld\n", res);
+        return res;
     }
 
     answertype puzzle2([[maybe_unused]] puzzle_options filename) {
-        auto input = get_stream(filename);
+        auto input = get_stream<ox::line>(filename);
         flower_map map(input);
-
-        positions area_template_iter_even = calculate_steps(map, map.find_start(), INPUT_WIDTH);
-        positions area_template_iter_odd = calculate_steps(map, map.find_start(), INPUT_WIDTH + 1);
-        positions2 area_template_even = pos_to_pos2(map, area_template_iter_even);
-        positions2 area_template_odd = pos_to_pos2(map, area_template_iter_odd);
-        area_map areas_even = get_area_part(area_template_even);
-        area_map areas_odd = get_area_part(area_template_odd);
-        area_test(areas_even, area_template_even);
-        area_test(areas_odd, area_template_odd);
-        long total_area = calculate_area(areas_even, areas_odd);
-        myprintf("%ld\n", total_area);
-        return total_area;
+        auto total_area = reachable(map, PART_2_STEPS);
+        if (!total_area) {
+            myprintf("The reachable area did not settle into quadratic growth within %ld map widths\n", MAX_SAMPLES);
+            return {};
+        }
+        myprintf("%ld\n", *total_area);
+        return *total_area;
     }
-} // namespace aoc2023::day21
\ No newline at end of file
+} // namespace aoc2023::day21
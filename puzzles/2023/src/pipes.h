@@ -9,8 +9,8 @@
 #include <algorithm>
 #include <bit>
 #include <ranges>
-#include <unordered_set>
-#include <deque>
+#include <cstdlib>
+#include <vector>
 
 enum PipeDir : uint8_t {
     Start = (1 << 5),
@@ -64,6 +64,9 @@ struct pipe_structure : ox::grid<uint8_t> {
     using ox::grid<uint8_t>::grid;
     using ox::grid<uint8_t>::const_raw_iterator;
 
+    long loop_length = 0;
+    long loop_twice_area = 0;
+
     auto calculate_start() {
         auto start_pos = stdr::find(data, Start);
         uint8_t matching_position = None;
@@ -96,156 +99,98 @@ struct pipe_structure : ox::grid<uint8_t> {
         uint8_t from = std::bit_floor(uint8_t(DIRECTION & *start));
         long distance = 0;
         auto head = std::optional(start);
+        auto [start_x, start_y] = coord_from_index(start);
+        long x = long(start_x), y = long(start_y);
         *start |= 1 << 5;
+        loop_twice_area = 0;
         do {
             ++distance;
             **head = PipeDir(MainLoop | **head);
+            long next_x = x, next_y = y;
             switch (next_direction(**head, from)) {
                 case N:
                     head = up(head);
                     from = S;
+                    --next_y;
                     break;
                 case S:
                     head = down(head);
                     from = N;
+                    ++next_y;
                     break;
                 case E:
                     head = right(head);
                     from = W;
+                    ++next_x;
                     break;
                 case W:
                     head = left(head);
                     from = E;
+                    --next_x;
                     break;
                 default: std::unreachable();
             }
+            loop_twice_area += x * next_y - next_x * y;
+            x = next_x;
+            y = next_y;
         } while (head != start);
+        loop_length = distance;
         return distance / 2;
     }
 
-    void within_loop(const raw_iterator& candidate) {
-        std::unordered_set<long> group;
-        std::queue<raw_iterator> Q;
-        Q.push(candidate);
-        group.insert(candidate - data.begin());
-
-        bool inbounds = true;
-        while (!Q.empty()) {
-            auto top = Q.front();
-            Q.pop();
-            auto cardinal = neighbour_range(top);
-            for (auto item : cardinal) {
-                if (!item || (**item & Outside)) {
-                    inbounds = false;
-                    break;
-                }
-                if (!(**item & MainLoop) && !(group.contains(*item - data.begin()))) {
-                    Q.push(*item);
-                    group.insert(*item - data.begin());
-                }
+    // Cells of the main loop, and the loop cells with a northward connection, packed one bit per cell for a row.
+    // Moving east along a row, the inside/outside parity flips exactly on the latter.
+    void pack_row(long y, std::vector<uint64_t>& loop, std::vector<uint64_t>& crossings) const {
+        auto row = data.begin() + y * long(get_width());
+        stdr::fill(loop, 0);
+        stdr::fill(crossings, 0);
+        for (size_t x = 0; x < get_width(); ++x) {
+            uint64_t bit = uint64_t(1) << (x % 64);
+            if (row[long(x)] & MainLoop) {
+                loop[x / 64] |= bit;
+                if (row[long(x)] & N)
+                    crossings[x / 64] |= bit;
             }
         }
-
-        for (auto index : group) {
-            data[index] = PipeDir(data[index] | (inbounds ? Inside : Outside));
-        }
     }
 
-    auto move_dir(std::optional<raw_iterator> head, uint8_t d) {
-        switch (d) {
-            case N: return up(head); break;
-            case S: return down(head); break;
-            case E: return right(head); break;
-            case W: return left(head); break;
-            default: std::unreachable();
-        }
-    }
-
-    static auto opposite(uint8_t from) {
-        switch (from) {
-            case N: return S; break;
-            case S: return N; break;
-            case E: return W; break;
-            case W: return E; break;
-            default: std::unreachable();
-        };
-    }
-    auto get_right(std::optional<raw_iterator> head, uint8_t back) {
-        switch (back) {
-            case N: return left(head); break;
-            case S: return right(head); break;
-            case E: return up(head); break;
-            case W: return down(head); break;
-            default: std::unreachable();
-        };
+    // Every bit set where an odd number of bits are set at or before it, carrying the parity of the previous word
+    static uint64_t prefix_parity(uint64_t x, bool& carry) {
+        for (int shift = 1; shift < 64; shift <<= 1)
+            x ^= x << shift;
+        if (carry)
+            x = ~x;
+        carry = x >> 63;
+        return x;
     }
 
-    static bool is_moving_left(std::optional<raw_iterator> head, uint8_t from) {
-        switch (from) {
-            case N: return (DIRECTION & **head) == NE; break;
-            case S: return (DIRECTION & **head) == SW; break;
-            case E: return (DIRECTION & **head) == SE; break;
-            case W: return (DIRECTION & **head) == NW; break;
-            default: std::unreachable();
-        }
-    }
-
-    void right_hand_rule() {
-        auto topleftpipe = std::optional(stdr::find_if(data, [](uint8_t d) { return d & MainLoop; }));
-        uint8_t from = next_direction(**topleftpipe, S);
-        auto head = std::optional(topleftpipe);
-        do {
-            switch (next_direction(**head, from)) {
-                case N:
-                    head = up(head);
-                    from = S;
-                    break;
-                case S:
-                    head = down(head);
-                    from = N;
-                    break;
-                case E:
-                    head = right(head);
-                    from = W;
-                    break;
-                case W:
-                    head = left(head);
-                    from = E;
-                    break;
-                default: std::unreachable();
-            }
-            auto right = get_right(head, from);
-            if (right && !(**right & MainLoop)) {
-                **right = PipeDir(Outside | **right);
-            }
-            if (is_moving_left(head, from)) {
-                PipeDir cont = opposite(from);
-                if (auto forward = move_dir(head, cont); forward && !(**forward & MainLoop)) {
-                    **forward = PipeDir(Outside | **forward);
-                }
-                if (auto diagonal = move_dir(right, cont); diagonal && !(**diagonal & MainLoop)) {
-                    **diagonal = PipeDir(Outside | **diagonal);
+    // Classifies every cell as Inside or Outside of the main loop with a single parity scan per row
+    long count_bounded() {
+        size_t words = (get_width() + 63) / 64;
+        std::vector<uint64_t> loop(words), crossings(words);
+        long count = 0;
+        for (long y = 0; y < long(get_height()); ++y) {
+            pack_row(y, loop, crossings);
+            auto row = data.begin() + y * long(get_width());
+            bool carry = false;
+            for (size_t w = 0; w < words; ++w) {
+                uint64_t inside = prefix_parity(crossings[w], carry) & ~loop[w];
+                size_t last = std::min<size_t>(64, get_width() - w * 64);
+                for (size_t b = 0; b < last; ++b) {
+                    auto& cell = row[long(w * 64 + b)];
+                    if (loop[w] >> b & 1)
+                        continue;
+                    cell = PipeDir((cell & ~(Inside | Outside)) | (inside >> b & 1 ? Inside : Outside));
                 }
+                count += std::popcount(inside & (last == 64 ? ~uint64_t(0) : (uint64_t(1) << last) - 1));
             }
-        } while (head != topleftpipe);
-    }
-
-    void check_remaining_bounds() {
-        auto start = data.begin();
-        auto end = data.end();
-        for (; start != end; ++start) {
-            if (*start & (MainLoop | Inside | Outside)) {
-                continue;
-            }
-            within_loop(start);
         }
+        return count;
     }
 
-    long count_bounded() {
-        right_hand_rule();
-        check_remaining_bounds();
-        return stdr::count_if(data, [](uint8_t d) { return d & Inside; });
-    }
+    // Only the count, from the loop walked by traverse_path: the shoelace formula gives the area enclosed by the
+    // loop through the cell centres, and Pick's theorem turns that into the number of cells strictly inside it.
+    [[nodiscard]] long enclosed_by_loop() const { return (std::abs(loop_twice_area) - loop_length) / 2 + 1; }
 
     void print() {
         leveled_foreach([](uint8_t c) { myprintf("\033[%sm%s", color(c), pipe_chars(c)); },